@@ -4,18 +4,232 @@
 #include "binary_collection.hpp"
 #include "hash_utils.hpp"
 #include "util.hpp"
+#include "configuration.hpp"
 #include "statistics_collectors.hpp"
 
+#include <succinct/mapper.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/progress.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
-#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 namespace ds2i {
 
+// Feeds the lists of [input] (as gaps if [compute_gaps]) to [collect],
+// sharding them among the worker threads: each thread fills its own copy
+// of [maps], then the copies are merged into [maps] one part at a time,
+// again in parallel. Returns the number of integers collected.
+template <typename Map, typename Collect>
+uint64_t collect_block_statistics(binary_collection& input, bool compute_gaps,
+                                  std::vector<Map>& maps, Collect collect) {
+    std::vector<binary_collection::sequence> lists;
+    uint64_t total_integers = 0;
+    auto it = input.begin();
+    if (compute_gaps) {
+        ++it;  // skip first singleton sequence, containing # of docs
+    }
+    for (; it != input.end(); ++it) {
+        if (it->size() > constants::min_size) {
+            lists.push_back(*it);
+            total_integers += it->size();
+        }
+    }
+
+    // NOTE: the maps have a part for each thread
+    size_t num_threads = maps.front().num_parts();
+    logger() << "collecting with " << num_threads << " threads" << std::endl;
+    boost::progress_display progress(total_integers);
+    std::mutex progress_mutex;
+    std::atomic<size_t> next_list(0);
+    static const size_t lists_per_job = 64;
+
+    std::vector<std::vector<Map>> local_maps(num_threads, maps);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            std::vector<uint32_t> buf;
+            size_t begin;
+            while ((begin = next_list.fetch_add(lists_per_job)) <
+                   lists.size()) {
+                size_t end = std::min(begin + lists_per_job, lists.size());
+                uint64_t integers = 0;
+                for (size_t l = begin; l != end; ++l) {
+                    auto const& list = lists[l];
+                    size_t n = list.size();
+                    buf.reserve(n);
+                    uint32_t prev = compute_gaps ? -1 : 0;
+                    auto it = list.begin();
+                    for (uint32_t i = 0; i < n; ++i, ++it) {
+                        buf.push_back(*it - prev - 1);
+                        if (compute_gaps) {
+                            prev = *it;
+                        }
+                    }
+                    collect(buf, local_maps[t]);
+                    buf.clear();
+                    integers += n;
+                }
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                progress += integers;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+
+    logger() << "merging..." << std::endl;
+    for (size_t p = 0; p != num_threads; ++p) {
+        threads.emplace_back([&, p]() {
+            for (size_t m = 0; m != maps.size(); ++m) {
+                for (size_t t = 0; t != num_threads; ++t) {
+                    maps[m].merge_part(local_maps[t][m], p);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    return total_integers;
+}
+
+// Selected blocks of each context, sorted by freq_length_sorter, in a flat
+// layout that is frozen to disk and mapped back with succinct::mapper, so
+// that cached statistics are used in place instead of being parsed.
+struct block_data {
+    struct block_view {
+        uint64_t freq;
+        uint32_t const* data;
+        uint32_t size;
+    };
+
+    // the blocks of a context
+    struct context_view {
+        size_t size() const {
+            return m_end - m_begin;
+        }
+
+        block_view operator[](size_t i) const {
+            assert(m_begin + i < m_end);
+            return m_blocks->block(m_begin + i);
+        }
+
+        block_data const* m_blocks;
+        uint64_t m_begin, m_end;
+    };
+
+    block_data() {}
+
+    void build(std::vector<std::vector<block_type>> const& blocks) {
+        std::vector<uint64_t> contexts(1, 0);
+        std::vector<uint64_t> freqs;
+        std::vector<uint64_t> endpoints(1, 0);
+        std::vector<uint32_t> data;
+        for (auto const& context : blocks) {
+            for (auto const& block : context) {
+                freqs.push_back(block.freq);
+                data.insert(data.end(), block.data.begin(), block.data.end());
+                endpoints.push_back(data.size());
+            }
+            contexts.push_back(freqs.size());
+        }
+        m_contexts.steal(contexts);
+        m_freqs.steal(freqs);
+        m_endpoints.steal(endpoints);
+        m_data.steal(data);
+    }
+
+    // number of contexts
+    size_t size() const {
+        return m_contexts.size() ? m_contexts.size() - 1 : 0;
+    }
+
+    context_view operator[](size_t s) const {
+        assert(s < size());
+        return {this, m_contexts[s], m_contexts[s + 1]};
+    }
+
+    block_view block(uint64_t i) const {
+        uint64_t begin = m_endpoints[i];
+        return {m_freqs[i], m_data.data() + begin,
+                uint32_t(m_endpoints[i + 1] - begin)};
+    }
+
+    void swap(block_data& other) {
+        m_contexts.swap(other.m_contexts);
+        m_freqs.swap(other.m_freqs);
+        m_endpoints.swap(other.m_endpoints);
+        m_data.swap(other.m_data);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(m_contexts, "m_contexts")(m_freqs, "m_freqs")(
+            m_endpoints, "m_endpoints")(m_data, "m_data");
+    }
+
+private:
+    // the blocks of context s are [m_contexts[s], m_contexts[s + 1]); the
+    // block i is m_data[m_endpoints[i], m_endpoints[i + 1])
+    succinct::mapper::mappable_vector<uint64_t> m_contexts;
+    succinct::mapper::mappable_vector<uint64_t> m_freqs;
+    succinct::mapper::mappable_vector<uint64_t> m_endpoints;
+    succinct::mapper::mappable_vector<uint32_t> m_data;
+};
+
+// Common storage of block_statistics and block_multi_statistics.
+struct block_statistics_base {
+    block_statistics_base() : total_integers(0) {}
+
+    // maps the statistics stored in [file_name] by try_to_store
+    void load(std::string const& file_name) {
+        m_file.open(file_name);
+        succinct::mapper::map(*this, m_file);
+        logger() << "mapped block stats (" << total_integers << " integers)"
+                 << std::endl;
+        for (size_t s = 0; s != blocks.size(); ++s) {
+            logger() << "\t" << blocks[s].size() << " blocks for context "
+                     << s << std::endl;
+        }
+    }
+
+    void try_to_store(std::string const& file_name) {
+        std::ofstream out(file_name.c_str(), std::ios::binary);
+        if (out) {
+            logger() << "storing stats to disk..." << std::endl;
+            succinct::mapper::freeze(*this, out);
+        } else {
+            logger() << "Cannot write block statistics to disk. Collection "
+                        "directory not writeable."
+                     << std::endl;
+        }
+    }
+
+    void swap(block_statistics_base& other) {
+        std::swap(total_integers, other.total_integers);
+        blocks.swap(other.blocks);
+        std::swap(m_file, other.m_file);
+    }
+
+    template <typename Visitor>
+    void map(Visitor& visit) {
+        visit(total_integers, "total_integers")(blocks, "blocks");
+    }
+
+    uint64_t total_integers;
+    block_data blocks;
+
+private:
+    boost::iostreams::mapped_file_source m_file;
+};
+
 template <typename Collector>
-struct block_statistics {
+struct block_statistics : block_statistics_base {
     static_assert(is_power_of_two(Collector::max_block_size), "");
+    typedef Collector collector_type;
+    typedef typename Collector::map_type map_type;
 
     static std::string type() {
         return "block_statistics-" + std::to_string(Collector::max_block_size) +
@@ -29,7 +243,7 @@ struct block_statistics {
         using namespace boost::filesystem;
         path p(file_name);
         std::string block_stats_filename =
-            "./" + p.filename().string() + "." + type();
+            "./" + p.filename().string() + "." + type() + ".bin";
 
         if (boost::filesystem::exists(block_stats_filename)) {
             return block_statistics(block_stats_filename);
@@ -48,129 +262,59 @@ struct block_statistics {
         logger() << "creating block stats (type = " << type() << ")"
                  << std::endl;
 
-        map_type block_map;
-        boost::progress_display progress(input.num_postings() -
-                                         (compute_gaps ? 2 : 0));
-        total_integers = 0;
-        std::vector<uint32_t> buf;
-
-        auto it = input.begin();
-        if (compute_gaps) {
-            ++it;  // skip first singleton sequence, containing # of docs
-        }
-
-        for (; it != input.end(); ++it) {
-            auto const& list = *it;
-            size_t n = list.size();
-            if (n > constants::min_size) {
-                total_integers += n;
-                progress += n + 1;
-                buf.reserve(n);
-                uint32_t prev = compute_gaps ? -1 : 0;
-                auto it = list.begin();
-                for (uint32_t i = 0; i < n; ++i, ++it) {
-                    buf.push_back(*it - prev - 1);
-                    if (compute_gaps) {
-                        prev = *it;
-                    }
-                }
-                Collector::collect(buf, block_map);
-                buf.clear();
-            }
-        }
+        size_t num_threads =
+            std::max<size_t>(1, configuration::get().worker_threads);
+        auto block_maps = Collector::create_maps(1, num_threads);
+        total_integers = collect_block_statistics(
+            input, compute_gaps, block_maps,
+            [](std::vector<uint32_t>& buf, std::vector<map_type>& maps) {
+                Collector::collect(buf, maps.front());
+            });
+        auto const& block_map = block_maps.front();
 
         logger() << "selecting entries..." << std::endl;
         uint64_t num_singletons = 0;
-        blocks.resize(1);
-        blocks.front().reserve(block_map.size());
-
-        for (auto& pair : block_map) {
-            auto& freq_block = pair.second;
-            if (freq_block.data.size() == 1) {
-                ++num_singletons;
-            }
-            if (filter(freq_block, total_integers) or
-                freq_block.data.size() == 1) {
-                block_type block;
-                block.freq = freq_block.freq;
-                block.data.swap(freq_block.data);
-                blocks.front().push_back(std::move(block));
-            }
-        }
+        std::vector<std::vector<block_type>> selected(1);
+        selected.front().reserve(block_map.size());
+
+        block_type freq_block;
+        block_map.for_each(
+            [&](uint64_t freq, uint32_t const* data, uint32_t size) {
+                freq_block.freq = freq;
+                freq_block.data.assign(data, data + size);
+                if (size == 1) {
+                    ++num_singletons;
+                }
+                if (filter(freq_block, total_integers) or size == 1) {
+                    selected.front().push_back(freq_block);
+                }
+            });
 
         logger() << "DONE" << std::endl;
 
         freq_length_sorter sorter;
         logger() << "sorting..." << std::endl;
         logger() << num_singletons << " singletons" << std::endl;
-        std::sort(blocks.front().begin(), blocks.front().end(), sorter);
+        std::sort(selected.front().begin(), selected.front().end(), sorter);
+        blocks.build(selected);
 
         logger() << "DONE" << std::endl;
     }
 
-    block_statistics(std::string file_name) {
-        std::ifstream in(file_name.c_str());
-        std::streamsize bytes = sizeof(uint32_t);
-        uint32_t num_blocks, size, freq;
-        in.read(reinterpret_cast<char*>(&total_integers), sizeof(uint64_t));
-        in.read(reinterpret_cast<char*>(&num_blocks), bytes);
-        logger() << "reading block stats (num_blocks = " << num_blocks << ")"
-                 << std::endl;
-        blocks.resize(1);
-
-        // NOTE: load only the needed entries
-        num_blocks = std::min<uint32_t>(constants::num_entries, num_blocks);
-
-        blocks.front().reserve(num_blocks);
-        uint32_t num_singletons = 0;
-        for (uint32_t i = 0; i < num_blocks; ++i) {
-            in.read(reinterpret_cast<char*>(&size), bytes);
-            in.read(reinterpret_cast<char*>(&freq), bytes);
-            block_type block;
-            block.freq = freq;
-            block.data.resize(size);
-            in.read(reinterpret_cast<char*>(block.data.data()), size * bytes);
-            if (size == 1) {
-                ++num_singletons;
-            }
-            blocks.front().push_back(std::move(block));
-        }
-        logger() << "\t" << num_singletons << " singletons" << std::endl;
-        logger() << "DONE" << std::endl;
+    block_statistics(std::string const& file_name) {
+        load(file_name);
     }
 
-    void try_to_store(std::string file_name) {
-        std::ofstream out(file_name.c_str());
-        if (out) {
-            logger() << "storing stats to disk..." << std::endl;
-            out.write(reinterpret_cast<char const*>(&total_integers),
-                      sizeof(uint64_t));
-            uint32_t num_blocks = blocks.front().size();
-            std::streamsize bytes = sizeof(uint32_t);
-            out.write(reinterpret_cast<char const*>(&num_blocks), bytes);
-            for (auto const& block : blocks.front()) {
-                uint32_t size = block.data.size();
-                uint32_t freq = block.freq;
-                out.write(reinterpret_cast<char const*>(&size), bytes);
-                out.write(reinterpret_cast<char const*>(&freq), bytes);
-                out.write(reinterpret_cast<char const*>(block.data.data()),
-                          size * bytes);
-            }
-            out.close();
-        } else {
-            logger() << "Cannot write block statistics to disk. Collection "
-                        "directory not writeable."
-                     << std::endl;
-        }
+    block_statistics(block_statistics&& other) {
+        swap(other);
     }
-
-    uint64_t total_integers;
-    std::vector<std::vector<block_type>> blocks;
 };
 
 template <typename Collector>
-struct block_multi_statistics {
+struct block_multi_statistics : block_statistics_base {
     static_assert(is_power_of_two(Collector::max_block_size), "");
+    typedef Collector collector_type;
+    typedef typename Collector::map_type map_type;
 
     static std::string type() {
         return "block_multi_statistics-" +
@@ -186,7 +330,7 @@ struct block_multi_statistics {
         using namespace boost::filesystem;
         path p(file_name);
         std::string block_stats_filename =
-            "./" + p.filename().string() + "." + type();
+            "./" + p.filename().string() + "." + type() + ".bin";
 
         if (boost::filesystem::exists(block_stats_filename)) {
             return block_multi_statistics(block_stats_filename);
@@ -212,59 +356,37 @@ struct block_multi_statistics {
             throw std::runtime_error("Unknown context.");
         }
 
-        std::vector<map_type> block_maps(constants::num_selectors);
-        boost::progress_display progress(input.num_postings() -
-                                         (compute_gaps ? 2 : 0));
-        total_integers = 0;
-        std::vector<uint32_t> buf;
-
-        auto it = input.begin();
-        if (compute_gaps) {
-            ++it;  // skip first singleton sequence, containing # of docs
-        }
-
-        for (; it != input.end(); ++it) {
-            auto const& list = *it;
-            size_t n = list.size();
-            if (n > constants::min_size) {
-                total_integers += n;
-                progress += n + 1;
-                buf.reserve(n);
-                uint32_t prev = compute_gaps ? -1 : 0;
-                auto it = list.begin();
-                for (uint32_t i = 0; i < n; ++i, ++it) {
-                    buf.push_back(*it - prev - 1);
-                    if (compute_gaps) {
-                        prev = *it;
-                    }
-                }
-                Collector::collect(buf, block_maps);
-                buf.clear();
-            }
-        }
+        size_t num_threads =
+            std::max<size_t>(1, configuration::get().worker_threads);
+        auto block_maps =
+            Collector::create_maps(constants::num_selectors, num_threads);
+        total_integers = collect_block_statistics(
+            input, compute_gaps, block_maps,
+            [](std::vector<uint32_t>& buf, std::vector<map_type>& maps) {
+                Collector::collect(buf, maps);
+            });
 
         logger() << "selecting entries..." << std::endl;
         std::vector<uint32_t> num_singletons(constants::num_selectors, 0);
-        blocks.resize(constants::num_selectors);
+        std::vector<std::vector<block_type>> selected(
+            constants::num_selectors);
         for (int s = 0; s != constants::num_selectors; ++s) {
-            blocks[s].reserve(block_maps[s].size());
+            selected[s].reserve(block_maps[s].size());
         }
 
         for (int s = 0; s != constants::num_selectors; ++s) {
-            auto& block_map = block_maps[s];
-            for (auto& pair : block_map) {
-                auto& freq_block = pair.second;
-                if (freq_block.data.size() == 1) {
-                    ++num_singletons[s];
-                }
-                if (filter(freq_block, total_integers) or
-                    freq_block.data.size() == 1) {
-                    block_type block;
-                    block.freq = freq_block.freq;
-                    block.data.swap(freq_block.data);
-                    blocks[s].push_back(std::move(block));
-                }
-            }
+            block_type freq_block;
+            block_maps[s].for_each(
+                [&](uint64_t freq, uint32_t const* data, uint32_t size) {
+                    freq_block.freq = freq;
+                    freq_block.data.assign(data, data + size);
+                    if (size == 1) {
+                        ++num_singletons[s];
+                    }
+                    if (filter(freq_block, total_integers) or size == 1) {
+                        selected[s].push_back(freq_block);
+                    }
+                });
         }
 
         logger() << "DONE" << std::endl;
@@ -275,86 +397,21 @@ struct block_multi_statistics {
             logger() << num_singletons[s]
                      << " singletons for blocks of context "
                      << constants::selector_codes[s] << std::endl;
-            logger() << "\tsaved " << blocks[s].size() << " blocks"
+            logger() << "\tsaved " << selected[s].size() << " blocks"
                      << std::endl;
-            std::sort(blocks[s].begin(), blocks[s].end(), sorter);
+            std::sort(selected[s].begin(), selected[s].end(), sorter);
         }
+        blocks.build(selected);
 
         logger() << "DONE" << std::endl;
     }
 
-    block_multi_statistics(std::string file_name) {
-        std::ifstream in(file_name.c_str());
-        std::streamsize bytes = sizeof(uint32_t);
-        uint32_t num_blocks, size, freq;
-        in.read(reinterpret_cast<char*>(&total_integers), sizeof(uint64_t));
-        std::cout << "total_integers " << total_integers << std::endl;
-        blocks.resize(constants::num_selectors);
-
-        for (int s = 0; s != constants::num_selectors; ++s) {
-            in.read(reinterpret_cast<char*>(&num_blocks), bytes);
-            logger() << "reading block stats for context "
-                     << constants::selector_codes[s]
-                     << " (num_blocks = " << num_blocks << ")" << std::endl;
-
-            // TODO
-            // // NOTE: load only the needed entries
-            // num_blocks = std::min<uint32_t>(constants::num_entries,
-            // num_blocks);
-
-            blocks[s].reserve(num_blocks);
-            uint32_t num_singletons = 0;
-            for (uint32_t i = 0; i < num_blocks; ++i) {
-                in.read(reinterpret_cast<char*>(&size), bytes);
-                in.read(reinterpret_cast<char*>(&freq), bytes);
-                block_type block;
-                block.freq = freq;
-                block.data.resize(size);
-                in.read(reinterpret_cast<char*>(block.data.data()),
-                        size * bytes);
-                if (size == 1) {
-                    ++num_singletons;
-                }
-                blocks[s].push_back(std::move(block));
-            }
-            logger() << "\t" << num_singletons << " singletons" << std::endl;
-        }
-
-        logger() << "DONE" << std::endl;
+    block_multi_statistics(std::string const& file_name) {
+        load(file_name);
     }
 
-    void try_to_store(std::string file_name) {
-        std::ofstream out(file_name.c_str());
-        if (out) {
-            logger() << "storing stats to disk..." << std::endl;
-            out.write(reinterpret_cast<char const*>(&total_integers),
-                      sizeof(uint64_t));
-
-            std::streamsize bytes = sizeof(uint32_t);
-            for (int s = 0; s != constants::num_selectors; ++s) {
-                uint32_t num_blocks = blocks[s].size();
-                out.write(reinterpret_cast<char const*>(&num_blocks), bytes);
-                for (auto const& block : blocks[s]) {
-                    uint32_t size = block.data.size();
-                    uint32_t freq = block.freq;
-                    out.write(reinterpret_cast<char const*>(&size), bytes);
-                    out.write(reinterpret_cast<char const*>(&freq), bytes);
-                    out.write(reinterpret_cast<char const*>(block.data.data()),
-                              size * bytes);
-                }
-                logger() << "written statistics for context "
-                         << constants::selector_codes[s] << std::endl;
-            }
-
-            out.close();
-        } else {
-            logger() << "Cannot write block statistics to disk. Collection "
-                        "directory not writeable."
-                     << std::endl;
-        }
+    block_multi_statistics(block_multi_statistics&& other) {
+        swap(other);
     }
-
-    uint64_t total_integers;
-    std::vector<std::vector<block_type>> blocks;
 };
 }  // namespace ds2i
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "hash_utils.hpp"
+
+namespace ds2i {
+
+// Flat, linear-probing map from dictionary entries to codewords, used by
+// the dictionary builders during encoding. Slots are keyed on the
+// window_hash of the entry and store the entry size next to the codeword;
+// since different entries can share a hash, a match is always verified
+// against the entry stored in the dictionary before being returned.
+struct codeword_table {
+    static const uint32_t invalid_index = uint32_t(-1);
+
+    codeword_table() : m_mask(0), m_collisions(0) {}
+
+    void init(uint64_t num_codewords) {
+        uint64_t capacity = 16;
+        while (capacity < 2 * num_codewords) {  // load factor <= 0.5
+            capacity *= 2;
+        }
+        m_slots.assign(capacity, slot());
+        m_mask = capacity - 1;
+        m_collisions = 0;
+    }
+
+    // [get(index)] must return a pointer to the entry of codeword [index];
+    // an entry already present in the table is re-assigned to [index]
+    template <typename Get>
+    void insert(uint32_t const* begin, uint32_t size, uint32_t index,
+                Get const& get) {
+        assert(index != invalid_index);
+        uint64_t hash = window_hash::hash(begin, size);
+        uint64_t i = hash & m_mask;
+        for (;; i = (i + 1) & m_mask) {
+            slot& s = m_slots[i];
+            if (s.index == invalid_index) {
+                s = {hash, index, size};
+                return;
+            }
+            if (s.hash == hash and s.size == size) {
+                if (std::equal(begin, begin + size, get(s.index))) {
+                    s.index = index;
+                    return;
+                }
+                ++m_collisions;
+            }
+        }
+    }
+
+    template <typename Get>
+    uint32_t find(uint32_t const* begin, uint32_t size, Get const& get) const {
+        return find(window_hash::hash(begin, size), begin, size, get);
+    }
+
+    // [hash] must be the window_hash of [begin, begin + size)
+    template <typename Get>
+    uint32_t find(uint64_t hash, uint32_t const* begin, uint32_t size,
+                  Get const& get) const {
+        assert(hash == window_hash::hash(begin, size));
+        uint64_t i = hash & m_mask;
+        for (;; i = (i + 1) & m_mask) {
+            slot const& s = m_slots[i];
+            if (s.index == invalid_index) {
+                return invalid_index;
+            }
+            if (s.hash == hash and s.size == size and
+                std::equal(begin, begin + size, get(s.index))) {
+                return s.index;
+            }
+        }
+    }
+
+    // number of distinct entries found with the same hash while inserting
+    uint64_t collisions() const {
+        return m_collisions;
+    }
+
+    bool empty() const {
+        return m_slots.empty();
+    }
+
+    void swap(codeword_table& other) {
+        m_slots.swap(other.m_slots);
+        std::swap(m_mask, other.m_mask);
+        std::swap(m_collisions, other.m_collisions);
+    }
+
+private:
+    struct slot {
+        uint64_t hash = 0;
+        uint32_t index = invalid_index;
+        uint32_t size = 0;
+    };
+
+    std::vector<slot> m_slots;
+    uint64_t m_mask;
+    uint64_t m_collisions;
+};
+
+}  // namespace ds2i
@@ -9,6 +9,8 @@
 #include "compact_elias_fano.hpp"
 #include "dict_posting_list.hpp"
 #include "block_statistics.hpp"
+#include "ordered_job_queue.hpp"
+#include "byte_arena.hpp"
 
 namespace ds2i {
 
@@ -24,7 +26,7 @@ struct dict_freq_index {
 
     struct builder {
         builder(uint64_t num_docs, global_parameters const& params)
-            : m_num_docs(num_docs), m_params(params), m_queue(1 << 24) {
+            : m_num_docs(num_docs), m_params(params) {
             m_endpoints.push_back(0);
         }
 
@@ -67,13 +69,22 @@ struct dict_freq_index {
             m_freqs_dict_builder.prepare_for_encoding();
         }
 
+        // Writes the lists to [filename] as they are committed, keeping at
+        // most about DS2I_BUILD_MEMORY_MB of them in memory; the lists of
+        // the index built are mapped from the file, which is removed with
+        // the builder.
+        void spill_lists_to(std::string const& filename) {
+            m_lists.spill_to(
+                filename, uint64_t(configuration::get().build_memory_mb) << 20);
+        }
+
         void build(dict_freq_index& dfi) {
             m_queue.complete();
 
             dfi.m_params = m_params;
             dfi.m_size = m_endpoints.size() - 1;
             dfi.m_num_docs = m_num_docs;
-            dfi.m_lists.steal(m_lists);
+            m_lists.release(dfi.m_lists);
 
             // NOTE: need single-threaded encoding
             // std::cout << "docs codewords: " << m_docs_dict_builder.codewords
@@ -102,7 +113,7 @@ struct dict_freq_index {
 
     private:
         template <typename DocsIterator, typename FreqsIterator>
-        struct list_adder : semiasync_queue::job {
+        struct list_adder : ordered_job_queue::job {
             list_adder(builder& b, DocsIterator docs_begin,
                        FreqsIterator freqs_begin, uint64_t n)
                 : b(b)
@@ -117,7 +128,7 @@ struct dict_freq_index {
             }
 
             virtual void commit() {
-                b.m_lists.insert(b.m_lists.end(), lists.begin(), lists.end());
+                b.m_lists.append(std::move(lists));
                 b.m_endpoints.push_back(b.m_lists.size());
             }
 
@@ -130,9 +141,9 @@ struct dict_freq_index {
 
         uint64_t m_num_docs;
         global_parameters m_params;
-        semiasync_queue m_queue;
+        ordered_job_queue m_queue;
         std::vector<uint64_t> m_endpoints;
-        std::vector<uint8_t> m_lists;
+        byte_arena m_lists;
         typename dictionary_type::builder m_docs_dict_builder;
         typename dictionary_type::builder m_freqs_dict_builder;
 
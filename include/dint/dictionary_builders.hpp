@@ -43,8 +43,14 @@ struct decreasing_static_frequencies {
     typedef Statistics statistics_type;
 
     static std::string type() {
-        return "DSF-" + std::to_string(dictionary_type::num_entries) + "-" +
-               std::to_string(dictionary_type::max_entry_size);
+        std::string t = "DSF-" + std::to_string(dictionary_type::num_entries) +
+                        "-" + std::to_string(dictionary_type::max_entry_size);
+        // NOTE: dictionaries built from exact statistics keep the same name
+        typedef typename statistics_type::collector_type collector_type;
+        if (!collector_type::exact) {
+            t += "-" + collector_type::type();
+        }
+        return t;
     }
 
     static auto filter() {
@@ -64,10 +70,10 @@ struct decreasing_static_frequencies {
                 n = stats.blocks[s].size();
             }
 
-            auto it = stats.blocks[s].begin();
-            for (uint64_t i = 0; i != n; ++i, ++it) {
-                auto const& block = *it;
-                dict_builder.append(block.data.data(), block.data.size(), s);
+            auto blocks = stats.blocks[s];
+            for (uint64_t i = 0; i != n; ++i) {
+                auto block = blocks[i];
+                dict_builder.append(block.data, block.size, s);
             }
         }
 
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <queue>
 #include <algorithm>
+#include <numeric>
+#include <unordered_map>
 
 #include <boost/progress.hpp>
 
@@ -13,22 +14,6 @@ bool prefix_overlap(t_entry& src, t_entry& target) {
                       target.begin() + src.size());
 }
 
-template <class t_entry>
-bool is_contained(t_entry& src, t_entry& target) {
-    return std::search(target.begin(), target.end(), src.begin(), src.end()) !=
-           target.end();
-}
-
-struct overlap_t {
-    size_t left;
-    size_t right;
-    size_t overlap;
-    overlap_t(size_t l, size_t r, size_t o) : left(l), right(r), overlap(o) {}
-    bool operator<(const overlap_t& other) const {
-        return overlap < other.overlap;
-    }
-};
-
 struct target_t {
     template <class t_itr>
     target_t(t_itr begin, t_itr end) : entry(begin, end){};
@@ -60,123 +45,235 @@ struct target_t {
     bool valid = true;
 };
 
-size_t compute_overlap(const std::vector<uint32_t>& A,
-                       const std::vector<uint32_t>& B) {
-    auto min_len = std::min(A.size(), B.size());
-    for (size_t l = 1; l <= min_len; l++) {
-        auto start = A.end() - l;
-        if (!std::equal(start, A.end(), B.begin())) {
-            return l - 1;
+// Aho-Corasick automaton over a set of targets. Each node of the trie
+// stands for a prefix of some target; [fail] points to the node of its
+// longest proper suffix that is also a prefix of some target and [output]
+// to the nearest node, along the failure links, where a target ends.
+struct targets_automaton {
+    static const uint32_t root = 0;
+    static const uint32_t none = uint32_t(-1);
+
+    struct node_t {
+        uint32_t symbol;
+        uint32_t depth;
+        uint32_t fail;
+        uint32_t output;
+        uint32_t target;
+    };
+
+    targets_automaton(std::vector<target_t> const& targets) {
+        size_t total_size = 0;
+        for (auto const& t : targets) total_size += t.entry.size();
+        m_nodes.reserve(total_size + 1);
+        m_children.reserve(total_size);
+        m_nodes.push_back({0, 0, root, none, none});
+        m_ends.reserve(targets.size());
+        for (uint32_t i = 0; i != targets.size(); ++i) {
+            uint32_t cur = root;
+            for (auto symbol : targets[i].entry) {
+                uint32_t next = child(cur, symbol);
+                if (next == none) {
+                    next = m_nodes.size();
+                    m_nodes.push_back({symbol, m_nodes[cur].depth + 1, root,
+                                       none, none});
+                    m_children[key(cur, symbol)] = next;
+                }
+                cur = next;
+            }
+            m_nodes[cur].target = i;
+            m_ends.push_back(cur);
         }
-    }
-    return min_len;
-}
 
-std::priority_queue<overlap_t> compute_all_overlaps(
-    std::vector<target_t>& entries) {
-    std::priority_queue<overlap_t> pq;
-    for (size_t i = 0; i < entries.size(); i++) {
-        for (size_t j = 0; j < entries.size(); j++) {
-            if (i != j) {
-                auto overlap =
-                    compute_overlap(entries[i].entry, entries[j].entry);
-                if (overlap > 1) {
-                    pq.emplace(i, j, overlap);
+        // failure links in breadth-first order: the failure link of a node
+        // is found following the failure links of its parent
+        std::vector<uint32_t> queue(1, root);
+        std::vector<std::vector<uint32_t>> children(m_nodes.size());
+        for (auto const& c : m_children) {
+            children[c.first >> 32].push_back(c.second);
+        }
+        for (size_t i = 0; i != queue.size(); ++i) {
+            uint32_t parent = queue[i];
+            for (auto cur : children[parent]) {
+                auto& n = m_nodes[cur];
+                if (parent != root) {
+                    n.fail = next(m_nodes[parent].fail, n.symbol);
                 }
+                auto const& f = m_nodes[n.fail];
+                n.output = f.target != none ? n.fail : f.output;
+                queue.push_back(cur);
             }
         }
     }
-    return pq;
-}
 
-void perform_greedy_prefix_suffix_overlap(std::vector<target_t>& entries) {
-    std::cout << "compute_all_overlaps" << std::endl;
-    auto overlaps = compute_all_overlaps(entries);
-    std::cout << "overlaps = " << overlaps.size() << std::endl;
-    std::cout << "merge overlapping entries" << std::endl;
-    size_t merges = 0;
-    size_t overlap_sum = 0;
-    while (!overlaps.empty()) {
-        auto cur = overlaps.top();
-        overlaps.pop();
-        if (!entries[cur.left].valid || !entries[cur.right].valid) {
-            continue;
+    uint32_t child(uint32_t node, uint32_t symbol) const {
+        auto it = m_children.find(key(node, symbol));
+        return it != m_children.end() ? it->second : none;
+    }
+
+    uint32_t next(uint32_t node, uint32_t symbol) const {
+        while (true) {
+            uint32_t c = child(node, symbol);
+            if (c != none) return c;
+            if (node == root) return root;
+            node = m_nodes[node].fail;
         }
+    }
 
-        // std::cout << merges << " overlaps = " << overlaps.size() << " " <<
-        // cur.overlap << std::endl;
-
-        // (a) merge the nodes
-        overlap_sum += cur.overlap;
-        auto& node_left = entries[cur.left];
-        auto copy_itr = entries[cur.right].entry.begin() + cur.overlap;
-        std::copy(copy_itr, entries[cur.right].entry.end(),
-                  std::back_inserter(node_left.entry));
-        target_t new_node = entries[cur.left];
-        entries.push_back(new_node);
-        // (b) remove the right node
-        entries[cur.left].valid = false;
-        entries[cur.right].valid = false;
-        for (size_t j = 0; j < entries.size() - 1; j++) {
-            if (!entries[j].valid)
-                continue;
-            auto overlap_left =
-                compute_overlap(entries[j].entry, entries.back().entry);
-            auto overlap_right =
-                compute_overlap(entries.back().entry, entries[j].entry);
-            if (overlap_left > 1) {
-                overlaps.emplace(j, entries.size() - 1, overlap_left);
-            }
-            if (overlap_right > 1) {
-                overlaps.emplace(entries.size() - 1, j, overlap_right);
+    node_t const& operator[](uint32_t node) const {
+        return m_nodes[node];
+    }
+
+    // node where the i-th target ends
+    uint32_t end(uint32_t i) const {
+        return m_ends[i];
+    }
+
+    size_t size() const {
+        return m_nodes.size();
+    }
+
+private:
+    static uint64_t key(uint32_t node, uint32_t symbol) {
+        return uint64_t(node) << 32 | symbol;
+    }
+
+    std::vector<node_t> m_nodes;
+    std::vector<uint32_t> m_ends;
+    std::unordered_map<uint64_t, uint32_t> m_children;
+};
+
+// offset of the first occurrence of each target in [table], found with a
+// single scan of the table through the automaton of the targets
+std::vector<uint32_t> locate_targets(std::vector<target_t> const& targets,
+                                     std::vector<uint32_t> const& table) {
+    static const uint32_t none = targets_automaton::none;
+    targets_automaton ac(targets);
+    std::vector<uint32_t> found_at(ac.size(), none);
+    uint32_t state = targets_automaton::root;
+    for (uint32_t pos = 0; pos != table.size(); ++pos) {
+        state = ac.next(state, table[pos]);
+        // NOTE: as in remove_contained_targets, the output chain of a node
+        // that has already been found has been found too
+        uint32_t cur = ac[state].target != none ? state : ac[state].output;
+        while (cur != none and found_at[cur] == none) {
+            found_at[cur] = pos + 1 - ac[cur].depth;
+            cur = ac[cur].output;
+        }
+    }
+
+    std::vector<uint32_t> offsets;
+    offsets.reserve(targets.size());
+    for (uint32_t i = 0; i != targets.size(); ++i) {
+        assert(found_at[ac.end(i)] != none);
+        offsets.push_back(found_at[ac.end(i)]);
+    }
+    return offsets;
+}
+
+// invalidates the targets that are a substring of a longer target
+void remove_contained_targets(std::vector<target_t>& entries) {
+    targets_automaton ac(entries);
+    std::vector<bool> contained(ac.size(), false);
+    for (uint32_t i = 0; i != entries.size(); ++i) {
+        uint32_t state = targets_automaton::root;
+        for (auto symbol : entries[i].entry) {
+            state = ac.next(state, symbol);
+            // NOTE: every node on the output chain of a contained node has
+            // already been marked, so the walk can stop there
+            uint32_t cur = ac[state].target != targets_automaton::none and
+                                   state != ac.end(i)
+                               ? state
+                               : ac[state].output;
+            while (cur != targets_automaton::none and !contained[cur]) {
+                contained[cur] = true;
+                cur = ac[cur].output;
             }
         }
-        ++merges;
     }
+    for (uint32_t i = 0; i != entries.size(); ++i) {
+        if (contained[ac.end(i)]) entries[i].valid = false;
+    }
+}
 
-    auto itr = entries.begin();
-    while (itr != entries.end()) {
-        if (itr->valid == false) {
-            itr = entries.erase(itr);
-        } else {
-            ++itr;
+// Greedy shortest common superstring of a substring-free set of targets:
+// targets are chained in decreasing order of suffix/prefix overlap, never
+// closing a cycle, and each chain becomes a single entry. The candidate
+// overlaps of a target are the nodes on the failure chain of its end node,
+// and the targets starting with such a node are those below it in the trie.
+void perform_greedy_prefix_suffix_overlap(std::vector<target_t>& entries) {
+    static const uint32_t none = targets_automaton::none;
+    targets_automaton ac(entries);
+    uint32_t n = entries.size();
+
+    // targets by prefix node, for all their proper prefixes
+    std::vector<std::vector<uint32_t>> starting(ac.size());
+    size_t max_depth = 0;
+    for (uint32_t j = 0; j != n; ++j) {
+        uint32_t cur = targets_automaton::root;
+        auto const& entry = entries[j].entry;
+        for (size_t d = 0; d + 1 < entry.size(); ++d) {
+            cur = ac.child(cur, entry[d]);
+            starting[cur].push_back(j);
         }
+        max_depth = std::max(max_depth, entry.size());
     }
+    std::vector<uint32_t> cursor(ac.size(), 0);
+
+    std::vector<uint32_t> succ(n, none), pred(n, none), overlap(n, 0);
+    std::vector<uint32_t> head(n), tail(n);  // of the chain of a tail/head
+    std::iota(head.begin(), head.end(), 0);
+    std::iota(tail.begin(), tail.end(), 0);
+    std::vector<uint32_t> state(n);
+    for (uint32_t i = 0; i != n; ++i) state[i] = ac[ac.end(i)].fail;
 
-    // perform single overlap merging
-    std::cout << "perform single overlap merging" << std::endl;
-    size_t total_merges_performed = 0;
-    for (size_t i = 0; i < entries.size(); i++) {
-        if (entries[i].valid == false)
-            continue;
-        auto last_sym = entries[i].entry.back();
-        for (size_t j = 0; j < entries.size(); j++) {
-            if (i != j) {
-                if (entries[j].valid == false)
-                    continue;
-                auto first_sym = entries[j].entry.front();
-                if (first_sym == last_sym) {
-                    entries[j].valid = false;
-                    total_merges_performed++;
-                    std::copy(entries[j].entry.begin() + 1,
-                              entries[j].entry.end(),
-                              std::back_inserter(entries[i].entry));
+    std::cout << "merge overlapping entries" << std::endl;
+    size_t merges = 0;
+    size_t overlap_sum = 0;
+    for (size_t k = max_depth; k != 0; --k) {
+        for (uint32_t i = 0; i != n; ++i) {
+            while (ac[state[i]].depth > k) state[i] = ac[state[i]].fail;
+            if (succ[i] != none or ac[state[i]].depth != k) continue;
+
+            // first target starting with the overlap that has no
+            // predecessor and is not the head of the chain of i
+            auto const& candidates = starting[state[i]];
+            uint32_t& c = cursor[state[i]];
+            while (c != candidates.size() and pred[candidates[c]] != none) ++c;
+            uint32_t j = none;
+            for (size_t p = c; p != candidates.size(); ++p) {
+                uint32_t cand = candidates[p];
+                if (pred[cand] == none and cand != head[i]) {
+                    j = cand;
                     break;
                 }
             }
+            if (j == none) continue;
+
+            succ[i] = j;
+            pred[j] = i;
+            overlap[j] = k;
+            uint32_t h = head[i], t = tail[j];
+            head[t] = h;
+            tail[h] = t;
+            overlap_sum += k;
+            ++merges;
         }
     }
-    std::cout << "singleton merges = " << total_merges_performed << std::endl;
-
-    itr = entries.begin();
-    while (itr != entries.end()) {
-        if (itr->valid == false) {
-            itr = entries.erase(itr);
-        } else {
-            ++itr;
+
+    std::vector<target_t> merged;
+    for (uint32_t i = 0; i != n; ++i) {
+        if (pred[i] != none) continue;
+        target_t cur = entries[i];
+        for (uint32_t j = succ[i]; j != none; j = succ[j]) {
+            auto const& entry = entries[j].entry;
+            cur.entry.insert(cur.entry.end(), entry.begin() + overlap[j],
+                             entry.end());
         }
+        merged.push_back(std::move(cur));
     }
+    entries.swap(merged);
 
+    std::cout << "merges = " << merges << std::endl;
     std::cout << "u32 overlap sum = " << overlap_sum << std::endl;
     std::cout << "non overlapping entries = " << entries.size() << std::endl;
 }
@@ -198,35 +295,15 @@ struct overlap_policy {
         auto last = std::unique(all_targets.begin(), all_targets.end());
         all_targets.erase(last, all_targets.end());
         std::cout << "all unique targets = " << all_targets.size() << std::endl;
-        {
-            std::cout << "find substr overlaps" << std::endl;
-            boost::progress_display progress(all_targets.size());
-            for (size_t i = 0; i < all_targets.size(); i++) {
-                auto& cur = all_targets[i];
-                for (size_t j = 0; j < all_targets.size(); j++) {
-                    auto& other = all_targets[j];
-                    if (i != j && other.valid &&
-                        cur.entry.size() < other.entry.size()) {
-                        if (is_contained(cur.entry, other.entry)) {
-                            cur.valid = false;
-                            break;
-                        }
-                    }
-                }
-                ++progress;
-            }
-        }
+        std::cout << "find substr overlaps" << std::endl;
+        remove_contained_targets(all_targets);
 
         std::cout << "remove substr overlaps" << std::endl;
         size_t size_before = all_targets.size();
-        auto itr = all_targets.begin();
-        while (itr != all_targets.end()) {
-            if (itr->valid == false) {
-                itr = all_targets.erase(itr);
-            } else {
-                ++itr;
-            }
-        }
+        all_targets.erase(
+            std::remove_if(all_targets.begin(), all_targets.end(),
+                           [](target_t const& t) { return !t.valid; }),
+            all_targets.end());
         size_t size_after = all_targets.size();
         std::cout << "before = " << size_before << std::endl;
         std::cout << "after = " << size_after << std::endl;
@@ -256,34 +333,34 @@ struct pack_policy {
         all_targets.erase(last, all_targets.end());
         std::cout << "all unique targets = " << all_targets.size() << std::endl;
         {
+            // NOTE: after sorting lexicographically, an entry that is a
+            // prefix of other entries immediately precedes one of them
             std::cout << "find prefix overlaps" << std::endl;
-            boost::progress_display progress(all_targets.size());
-            for (size_t i = 0; i < all_targets.size(); i++) {
-                auto& cur = all_targets[i];
-                for (size_t j = 0; j < all_targets.size(); j++) {
-                    auto& other = all_targets[j];
-                    if (i != j && other.valid &&
-                        cur.entry.size() < other.entry.size()) {
-                        if (prefix_overlap(cur.entry, other.entry)) {
-                            cur.valid = false;
-                            break;
-                        }
-                    }
+            std::vector<uint32_t> lex_order(all_targets.size());
+            std::iota(lex_order.begin(), lex_order.end(), 0);
+            std::sort(lex_order.begin(), lex_order.end(),
+                      [&](uint32_t l, uint32_t r) {
+                          auto const& x = all_targets[l].entry;
+                          auto const& y = all_targets[r].entry;
+                          return std::lexicographical_compare(
+                              x.begin(), x.end(), y.begin(), y.end());
+                      });
+            for (size_t i = 0; i + 1 < lex_order.size(); i++) {
+                auto& cur = all_targets[lex_order[i]];
+                auto& next = all_targets[lex_order[i + 1]];
+                if (cur.entry.size() < next.entry.size() &&
+                    prefix_overlap(cur.entry, next.entry)) {
+                    cur.valid = false;
                 }
-                ++progress;
             }
         }
 
         std::cout << "remove prefix overlaps" << std::endl;
         size_t size_before = all_targets.size();
-        auto itr = all_targets.begin();
-        while (itr != all_targets.end()) {
-            if (itr->valid == false) {
-                itr = all_targets.erase(itr);
-            } else {
-                ++itr;
-            }
-        }
+        all_targets.erase(
+            std::remove_if(all_targets.begin(), all_targets.end(),
+                           [](target_t const& t) { return !t.valid; }),
+            all_targets.end());
         size_t size_after = all_targets.size();
         std::cout << "before = " << size_before << std::endl;
         std::cout << "after = " << size_after << std::endl;
@@ -1,8 +1,22 @@
 #pragma once
 
+#include <immintrin.h>
+
 #include "util.hpp"
 #include "dint_configuration.hpp"
 #include "statistics_collectors.hpp"
+#include "dint_exceptions.hpp"
+#include "single_dictionary.hpp"
+#include "multi_dictionary.hpp"
+
+// Opt-in vectorized decoding of groups of dictionary codewords, enabled
+// with cmake -DDINT_VECTORIZED_DECODE=ON. It is off by default since the
+// scalar loop decoded faster on the machines we measured.
+#if defined(DS2I_DINT_VECTORIZED_DECODE) && defined(__AVX2__)
+#define DS2I_DINT_GROUP_SIZE 8
+#elif defined(DS2I_DINT_VECTORIZED_DECODE) && defined(__SSE4_1__)
+#define DS2I_DINT_GROUP_SIZE 4
+#endif
 
 namespace ds2i {
 
@@ -10,6 +24,24 @@ struct dint_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = 256;
 
+    // specialized decoding for packed dictionaries, i.e., those storing
+    // a (size, offset) word per codeword and the entries in a separate table
+    template <uint32_t t_num_entries, uint32_t t_max_entry_size,
+              typename CompactingPolicy>
+    static uint8_t const* decode(
+        single_dictionary<t_num_entries, t_max_entry_size,
+                          CompactingPolicy> const& dict,
+        uint8_t const* in, uint32_t* out, uint32_t sum_of_values, size_t n) {
+        if (DS2I_UNLIKELY(n < block_size)) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+
+        uint16_t const* ptr = reinterpret_cast<uint16_t const*>(in);
+        ptr = decode_packed<t_max_entry_size>(
+            dict.offsets(), dict.num_offsets(), dict.table(), ptr, out, n);
+        return reinterpret_cast<uint8_t const*>(ptr);
+    }
+
     template <typename Dictionary>
     static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
                                  uint32_t* out, uint32_t sum_of_values,
@@ -47,6 +79,191 @@ struct dint_block {
         // if b = 8
         // return ptr;
     }
+
+    // Decodes n integers from the 16-bit codewords in [ptr, ...), where
+    // offsets[i] = ((size - 1) << 24) | offset locates the i-th entry in
+    // table. With DS2I_DINT_GROUP_SIZE defined, the codewords preceding
+    // the next exception are resolved DS2I_DINT_GROUP_SIZE at a time: the
+    // (size, offset) words are gathered at once, the output positions are
+    // the exclusive prefix sum of the sizes and every entry is copied with
+    // unaligned vector stores. Exceptions are decoded one at a time.
+    template <uint32_t max_entry_size>
+    static uint16_t const* decode_packed(uint32_t const* offsets,
+                                         uint32_t num_offsets,
+                                         uint32_t const* table,
+                                         uint16_t const* ptr, uint32_t* out,
+                                         size_t n) {
+        assert(num_offsets > 0);
+        (void)num_offsets;
+        uint32_t* end = out + n;
+        while (out != end) {
+#ifdef DS2I_DINT_GROUP_SIZE
+            static_assert(max_entry_size == 16,
+                          "vectorized copies assume entries of 16 integers");
+            static const uint64_t group_bytes =
+                DS2I_DINT_GROUP_SIZE * sizeof(uint16_t);
+            // NOTE: a group may span past the end of the block, so never
+            // load across a page boundary
+            if (DS2I_LIKELY((reinterpret_cast<uintptr_t>(ptr) & 4095) <=
+                            4096 - group_bytes)) {
+                uint32_t decoded_codewords = 0;
+                uint32_t decoded_ints = decode_group(
+                    offsets, num_offsets, table, ptr, out, end - out,
+                    decoded_codewords);
+                if (decoded_codewords) {
+                    ptr += decoded_codewords;
+                    out += decoded_ints;
+                    continue;
+                }
+            }
+#endif
+            uint32_t index = *ptr;
+            if (DS2I_LIKELY(index > EXCEPTIONS - 1)) {
+                uint32_t size_and_offset = offsets[index];
+                memcpy(out, table + (size_and_offset & 0xFFFFFF),
+                       max_entry_size * sizeof(uint32_t));
+                out += (size_and_offset >> 24) + 1;
+            } else {
+                if (index == 1) {  // 4-byte exception
+                    *out = *(reinterpret_cast<uint32_t const*>(++ptr));
+                    ++ptr;
+                } else {  // 2-byte exception
+                    *out = *(++ptr);
+                }
+                ++out;
+            }
+            ++ptr;
+        }
+        return ptr;
+    }
+
+private:
+#if DS2I_DINT_GROUP_SIZE == 8
+    // resolves up to 8 leading non-exception codewords producing at most
+    // [remaining] integers; returns the number of decoded integers
+    static uint32_t decode_group(uint32_t const* offsets, uint32_t num_offsets,
+                                 uint32_t const* table, uint16_t const* ptr,
+                                 uint32_t* out, uint32_t remaining,
+                                 uint32_t& decoded_codewords) {
+        alignas(32) uint32_t positions[8];
+        alignas(32) uint32_t entries[8];
+
+        __m256i indexes = _mm256_cvtepu16_epi32(
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr)));
+        uint32_t exceptions = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(EXCEPTIONS), indexes)));
+        uint32_t codewords = __builtin_ctz(exceptions | 0x100);
+        if (!codewords) {
+            decoded_codewords = 0;
+            return 0;
+        }
+
+        // codewords past the end of the block are garbage:
+        // clamp them to stay within the offsets
+        indexes = _mm256_min_epu32(indexes, _mm256_set1_epi32(num_offsets - 1));
+        __m256i size_and_offset = _mm256_i32gather_epi32(
+            reinterpret_cast<int const*>(offsets), indexes, 4);
+        __m256i sizes = _mm256_add_epi32(_mm256_srli_epi32(size_and_offset, 24),
+                                         _mm256_set1_epi32(1));
+        _mm256_store_si256(
+            reinterpret_cast<__m256i*>(entries),
+            _mm256_and_si256(size_and_offset, _mm256_set1_epi32(0xFFFFFF)));
+
+        // inclusive prefix sum of the sizes
+        __m256i sums = _mm256_add_epi32(sizes, _mm256_slli_si256(sizes, 4));
+        sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+        sums = _mm256_add_epi32(
+            sums, _mm256_blend_epi32(
+                      _mm256_setzero_si256(),
+                      _mm256_permutevar8x32_epi32(
+                          sums, _mm256_setr_epi32(0, 0, 0, 0, 3, 3, 3, 3)),
+                      0xF0));
+        __m256i starts = _mm256_sub_epi32(sums, sizes);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(positions), starts);
+
+        // only the codewords starting before the end of the block belong
+        // to it, since the block codewords produce exactly n integers
+        uint32_t in_block = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), starts)));
+        codewords = __builtin_popcount(in_block & ((1 << codewords) - 1));
+
+        for (uint32_t j = 0; j != codewords; ++j) {
+            __m256i const* src =
+                reinterpret_cast<__m256i const*>(table + entries[j]);
+            __m256i* dst = reinterpret_cast<__m256i*>(out + positions[j]);
+            __m256i lo = _mm256_loadu_si256(src);
+            __m256i hi = _mm256_loadu_si256(src + 1);
+            _mm256_storeu_si256(dst, lo);
+            _mm256_storeu_si256(dst + 1, hi);
+        }
+
+        alignas(32) uint32_t ends[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(ends), sums);
+        decoded_codewords = codewords;
+        return ends[codewords - 1];
+    }
+#elif DS2I_DINT_GROUP_SIZE == 4
+    // resolves up to 4 leading non-exception codewords producing at most
+    // [remaining] integers; returns the number of decoded integers
+    static uint32_t decode_group(uint32_t const* offsets, uint32_t num_offsets,
+                                 uint32_t const* table, uint16_t const* ptr,
+                                 uint32_t* out, uint32_t remaining,
+                                 uint32_t& decoded_codewords) {
+        alignas(16) uint32_t indexes[4];
+        alignas(16) uint32_t positions[4];
+
+        __m128i codewords_vec = _mm_cvtepu16_epi32(
+            _mm_loadl_epi64(reinterpret_cast<__m128i const*>(ptr)));
+        uint32_t exceptions = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmplt_epi32(codewords_vec, _mm_set1_epi32(EXCEPTIONS))));
+        uint32_t codewords = __builtin_ctz(exceptions | 0x10);
+        if (!codewords) {
+            decoded_codewords = 0;
+            return 0;
+        }
+
+        codewords_vec =
+            _mm_min_epu32(codewords_vec, _mm_set1_epi32(num_offsets - 1));
+        _mm_store_si128(reinterpret_cast<__m128i*>(indexes), codewords_vec);
+        __m128i size_and_offset =
+            _mm_setr_epi32(offsets[indexes[0]], offsets[indexes[1]],
+                           offsets[indexes[2]], offsets[indexes[3]]);
+        __m128i sizes = _mm_add_epi32(_mm_srli_epi32(size_and_offset, 24),
+                                      _mm_set1_epi32(1));
+        _mm_store_si128(
+            reinterpret_cast<__m128i*>(indexes),
+            _mm_and_si128(size_and_offset, _mm_set1_epi32(0xFFFFFF)));
+
+        // inclusive prefix sum of the sizes
+        __m128i sums = _mm_add_epi32(sizes, _mm_slli_si128(sizes, 4));
+        sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+        __m128i starts = _mm_sub_epi32(sums, sizes);
+        _mm_store_si128(reinterpret_cast<__m128i*>(positions), starts);
+
+        uint32_t in_block = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpgt_epi32(_mm_set1_epi32(remaining), starts)));
+        codewords = __builtin_popcount(in_block & ((1 << codewords) - 1));
+
+        for (uint32_t j = 0; j != codewords; ++j) {
+            __m128i const* src =
+                reinterpret_cast<__m128i const*>(table + indexes[j]);
+            __m128i* dst = reinterpret_cast<__m128i*>(out + positions[j]);
+            __m128i x0 = _mm_loadu_si128(src);
+            __m128i x1 = _mm_loadu_si128(src + 1);
+            __m128i x2 = _mm_loadu_si128(src + 2);
+            __m128i x3 = _mm_loadu_si128(src + 3);
+            _mm_storeu_si128(dst, x0);
+            _mm_storeu_si128(dst + 1, x1);
+            _mm_storeu_si128(dst + 2, x2);
+            _mm_storeu_si128(dst + 3, x3);
+        }
+
+        alignas(16) uint32_t ends[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(ends), sums);
+        decoded_codewords = codewords;
+        return ends[codewords - 1];
+    }
+#endif
 };
 
 struct greedy_dint_single_dict_block {
@@ -138,14 +355,39 @@ private:
     }
 };
 
+// Buffers of the optimal parsers, kept by each thread and reused for all
+// the blocks it encodes: once they have grown to the size of a block,
+// encoding a block does not allocate.
+struct dint_scratch {
+    window_hashes hashes;
+    std::vector<node> path;
+    std::vector<node> encoding;
+    std::vector<uint8_t> best;
+    std::vector<uint8_t> trial;
+
+    static dint_scratch& get() {
+        thread_local dint_scratch scratch;
+        return scratch;
+    }
+};
+
 struct opt_dint_single_dict_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = dint_block::overflow;
 
+    // computes the optimal parsing of [begin, begin + n) into [encoding]:
+    // the i-th node holds the codeword starting at position
+    // encoding[i].parent and the last node is a dummy with parent n;
+    // [encoding] may be the one of the scratch
     template <typename Builder>
-    static void encode(Builder& builder, uint32_t const* begin, uint64_t n,
-                       std::vector<uint8_t>& out, uint32_t b) {
-        std::vector<node> path(n + 2);
+    static void parse(Builder& builder, uint32_t const* begin, uint64_t n,
+                      std::vector<node>& encoding) {
+        auto& scratch = dint_scratch::get();
+        auto& hashes = scratch.hashes;
+        hashes.compute(begin, n, Builder::max_entry_size);
+
+        auto& path = scratch.path;
+        path.resize(n + 2);
         path[0] = {0, 1, 0};  // dummy node
         for (uint32_t i = 1; i < n + 1; ++i) {
             path[i] = {i - 1, 1, 3 * i};
@@ -184,7 +426,7 @@ struct opt_dint_single_dict_block {
             for (uint32_t s = 0; s < constants::num_target_sizes; ++s) {
                 uint32_t sub_block_size = constants::target_sizes[s];
                 uint32_t len = std::min<uint32_t>(sub_block_size, n - i);
-                index = builder.lookup(begin + i, len);
+                index = builder.lookup(begin + i, len, hashes(i, len));
                 if (index != Builder::invalid_index) {
                     uint32_t c = path[i].cost + 1;
                     if (path[i + len].cost > c) {
@@ -209,7 +451,7 @@ struct opt_dint_single_dict_block {
             }
         }
 
-        std::vector<node> encoding;
+        encoding.clear();
         uint32_t i = n;
         while (i != 0) {
             uint32_t parent = path[i].parent;
@@ -219,6 +461,13 @@ struct opt_dint_single_dict_block {
 
         std::reverse(encoding.begin(), encoding.end());
         encoding.emplace_back(n, 1, -1);  // final dummy node
+    }
+
+    template <typename Builder>
+    static void encode(Builder& builder, uint32_t const* begin, uint64_t n,
+                       std::vector<uint8_t>& out, uint32_t b) {
+        auto& encoding = dint_scratch::get().encoding;
+        parse(builder, begin, n, encoding);
 
         uint32_t pos = 0;
         for (uint32_t i = 0; i < encoding.size() - 1; ++i) {
@@ -282,6 +531,38 @@ private:
     }
 };
 
+struct opt_dint_single_dict_exceptions_block {
+    static const uint64_t block_size = constants::block_size;
+    static const uint64_t overflow = dint_block::overflow;
+
+    // same parsing as opt_dint_single_dict_block, but with the exceptions
+    // laid out as described in dint_exceptions
+    template <typename Builder>
+    static void encode(Builder& builder, uint32_t const* in,
+                       uint32_t sum_of_values, uint32_t n,
+                       std::vector<uint8_t>& out) {
+        if (n < block_size) {
+            interpolative_block::encode(in, sum_of_values, n, out);
+            return;
+        }
+
+        auto& encoding = dint_scratch::get().encoding;
+        opt_dint_single_dict_block::parse(builder, in, n, encoding);
+        dint_exceptions::write(encoding, in, n, out);
+    }
+
+    template <typename Dictionary>
+    static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
+                                 uint32_t* out, uint32_t sum_of_values,
+                                 size_t n) {
+        if (DS2I_UNLIKELY(n < block_size)) {
+            return interpolative_block::decode(in, out, sum_of_values, n);
+        }
+
+        return dint_exceptions::decode(dict, in, out, n);
+    }
+};
+
 struct opt_dint_multi_dict_block {
     static const uint64_t block_size = constants::block_size;
     static const uint64_t overflow = dint_block::overflow;
@@ -290,13 +571,33 @@ struct opt_dint_multi_dict_block {
     static void encode(Builder& builder, uint32_t dictionary_id,
                        uint32_t const* begin, uint64_t n,
                        std::vector<uint8_t>& out, uint32_t b) {
-        std::vector<node> path(n + 2);
+        auto& hashes = dint_scratch::get().hashes;
+        hashes.compute(begin, n, Builder::max_entry_size);
+        encode(builder, dictionary_id, begin, n, hashes, out, b);
+    }
+
+    // [hashes] must have been computed over [begin, begin + n). Gives up,
+    // leaving [out] untouched, and returns false as soon as the encoding
+    // is known to take at least [size_limit] bytes.
+    template <typename Builder>
+    static bool encode(Builder& builder, uint32_t dictionary_id,
+                       uint32_t const* begin, uint64_t n,
+                       window_hashes const& hashes, std::vector<uint8_t>& out,
+                       uint32_t b, size_t size_limit = size_t(-1)) {
+        auto& scratch = dint_scratch::get();
+        auto& path = scratch.path;
+        path.resize(n + 2);
         path[0] = {0, 1, 0};  // dummy node
         for (uint32_t i = 1; i < n + 1; ++i) {
             path[i] = {i - 1, 1, 3 * i};
         }
 
         for (uint32_t i = 0; i < n; ++i) {
+            if (i % prune_interval == 0 and size_limit != size_t(-1) and
+                min_cost_from(path, i, n) * (b / 8) >= size_limit) {
+                return false;
+            }
+
             uint32_t longest_run_size = 0;
             uint32_t run_size = std::min<uint64_t>(256, n - i);
             uint32_t index = EXCEPTIONS;
@@ -329,7 +630,8 @@ struct opt_dint_multi_dict_block {
             for (uint32_t s = 0; s < constants::num_target_sizes; ++s) {
                 uint32_t sub_block_size = constants::target_sizes[s];
                 uint32_t len = std::min<uint32_t>(sub_block_size, n - i);
-                index = builder.lookup(dictionary_id, begin + i, len, b);
+                index = builder.lookup(dictionary_id, begin + i, len, b,
+                                       hashes(i, len));
                 if (index != Builder::invalid_index) {
                     uint32_t c = path[i].cost + 1;
                     if (path[i + len].cost > c) {
@@ -354,7 +656,8 @@ struct opt_dint_multi_dict_block {
             }
         }
 
-        std::vector<node> encoding;
+        auto& encoding = scratch.encoding;
+        encoding.clear();
         uint32_t i = n;
         while (i != 0) {
             uint32_t parent = path[i].parent;
@@ -397,6 +700,7 @@ struct opt_dint_multi_dict_block {
         }
 
         assert(pos == n);
+        return true;
     }
 
     template <typename Builder>
@@ -408,28 +712,45 @@ struct opt_dint_multi_dict_block {
             return;
         }
 
-        // Option (1): choose the best dictionary
-        std::vector<std::vector<uint8_t>> encoded(2 * constants::num_selectors);
+        // Option (1): choose the best dictionary, i.e., the smallest
+        // encoding and, among those of the same size, the one with the
+        // smallest selector code, the 8-bit codewords coming first. The
+        // trials are started from the selector guessed from the largest
+        // value, which is most often the best, so that the following ones
+        // can be given up as soon as they cannot be smaller.
+        auto& scratch = dint_scratch::get();
+        auto& hashes = scratch.hashes;
+        hashes.compute(in, n, Builder::max_entry_size);
+        // only the best encoding so far is kept, in scratch.best
+        auto& best = scratch.best;
+        auto& trial = scratch.trial;
         size_t best_size = size_t(-1);
+        uint32_t best_rank = 0;
         uint32_t selector_code = 0;
-        for (uint32_t s = 0; s != constants::num_selectors; ++s) {
-            encode(builder, s, in, n, encoded[s], 16);
-            encode(builder, s, in, n, encoded[s + constants::num_selectors], 8);
-            size_t smallest_size = encoded[s].size();
-            uint32_t sc = s;
-            if (encoded[s + constants::num_selectors].size() <= smallest_size) {
-                smallest_size = encoded[s + constants::num_selectors].size();
-                sc += constants::num_selectors;
-            }
-            if (smallest_size < best_size) {
-                best_size = smallest_size;
-                selector_code = sc;
+        uint32_t guess = selector().get(in, n);
+        for (uint32_t k = 0; k != constants::num_selectors; ++k) {
+            uint32_t s = (guess + k) % constants::num_selectors;
+            for (uint32_t b : {8, 16}) {
+                uint32_t rank = 2 * s + (b == 16);
+                // an encoding of the same size as the best one only
+                // replaces it if it comes first
+                size_t size_limit = best_size;
+                if (best_size != size_t(-1) and rank < best_rank) {
+                    size_limit += 1;
+                }
+                trial.clear();
+                if (encode(builder, s, in, n, hashes, trial, b, size_limit) and
+                    trial.size() < size_limit) {
+                    best_size = trial.size();
+                    best_rank = rank;
+                    selector_code = s + (b == 8) * constants::num_selectors;
+                    best.swap(trial);
+                }
             }
         }
         // control byte
         out.push_back(selector_code);
-        out.insert(out.end(), encoded[selector_code].begin(),
-                   encoded[selector_code].end());
+        out.insert(out.end(), best.begin(), best.end());
 
         // // Option (2): select the dictionary based on the context
         // selector sct;
@@ -468,22 +789,10 @@ struct opt_dint_multi_dict_block {
         uint8_t selector_code = *in;
         if (selector_code < constants::num_selectors) {
             uint16_t const* ptr = reinterpret_cast<uint16_t const*>(in + 1);
-            for (size_t i = 0; i != n; ++ptr) {
-                uint32_t index = *ptr;
-                uint32_t decoded_ints = 1;
-                if (DS2I_LIKELY(index > EXCEPTIONS - 1)) {
-                    decoded_ints = multi_dict.copy(selector_code, index, out);
-                } else {
-                    if (index == 1) {  // 4-byte exception
-                        *out = *(reinterpret_cast<uint32_t const*>(++ptr));
-                        ++ptr;
-                    } else {  // 2-byte exception
-                        *out = *(++ptr);
-                    }
-                }
-                out += decoded_ints;
-                i += decoded_ints;
-            }
+            ptr = dint_block::decode_packed<MultiDictionary::max_entry_size>(
+                multi_dict.offsets(selector_code),
+                multi_dict.num_offsets(selector_code), multi_dict.table(), ptr,
+                out, n);
             return reinterpret_cast<uint8_t const*>(ptr);
         } else {
             selector_code -= constants::num_selectors;
@@ -510,6 +819,23 @@ struct opt_dint_multi_dict_block {
     }
 
 private:
+    // number of positions parsed between two checks of the size limit
+    static const uint32_t prune_interval = 16;
+
+    // lower bound on the cost of the parsing when the positions before
+    // [i] have been processed: every parsing reaches a position in
+    // [i, n] with a codeword starting before i, hence at a cost not
+    // smaller than the one found so far for that position. An encoding
+    // takes at least b / 8 bytes per unit of cost.
+    static uint64_t min_cost_from(std::vector<node> const& path, uint32_t i,
+                                  uint64_t n) {
+        uint32_t cost = path[i].cost;
+        for (uint64_t j = i + 1; j <= n; ++j) {
+            cost = std::min(cost, path[j].cost);
+        }
+        return cost;
+    }
+
     static void write_index(uint32_t index, std::vector<uint8_t>& out,
                             uint32_t b) {
         auto ptr = reinterpret_cast<uint8_t const*>(&index);
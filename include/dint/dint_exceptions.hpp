@@ -0,0 +1,141 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include "util.hpp"
+#include "dint_configuration.hpp"
+
+namespace ds2i {
+
+// Alternative layout of a DINT block that moves the exceptions out of the
+// codeword stream:
+//
+//   [header] [exceptions] [codewords]
+//
+// The 16-bit header stores the number of exceptions and, in its most
+// significant bit, whether they are written with 4 bytes (if any of them
+// does not fit in 2 bytes) or 2 bytes. In the codeword stream, index 0
+// stands for the next exception and index 1, followed by a 16-bit length
+// k, for the next k exceptions. Decoding a run of exceptions is thus a
+// single branch followed by a bulk unpack.
+struct dint_exceptions {
+    static const uint32_t single_exception = 0;
+    static const uint32_t exceptions_run = 1;
+    static const uint32_t wide_exceptions = 1 << 15;
+
+    // encoding is the optimal parsing of [begin, begin + n), terminated by
+    // a dummy node, as computed by opt_dint_single_dict_block::parse
+    static void write(std::vector<node> const& encoding,
+                      uint32_t const* begin, uint64_t n,
+                      std::vector<uint8_t>& out) {
+        uint32_t num_exceptions = 0;
+        bool wide = false;
+        for (uint32_t i = 0; i < encoding.size() - 1; ++i) {
+            if (encoding[i].codeword < EXCEPTIONS) {
+                uint32_t exception = begin[encoding[i].parent];
+                wide |= exception > 65536 - 1;
+                ++num_exceptions;
+            }
+        }
+        assert(num_exceptions < wide_exceptions);
+
+        write_u16(num_exceptions | (wide ? wide_exceptions : 0), out);
+        for (uint32_t i = 0; i < encoding.size() - 1; ++i) {
+            if (encoding[i].codeword < EXCEPTIONS) {
+                uint32_t exception = begin[encoding[i].parent];
+                auto ptr = reinterpret_cast<uint8_t const*>(&exception);
+                out.insert(out.end(), ptr, ptr + (wide ? 4 : 2));
+            }
+        }
+
+        for (uint32_t i = 0; i < encoding.size() - 1;) {
+            if (encoding[i].codeword > EXCEPTIONS - 1) {
+                write_u16(encoding[i].codeword, out);
+                ++i;
+                continue;
+            }
+
+            uint32_t run = 1;
+            while (i + run < encoding.size() - 1 and
+                   encoding[i + run].codeword < EXCEPTIONS) {
+                ++run;
+            }
+            if (run == 1) {
+                write_u16(single_exception, out);
+            } else {
+                write_u16(exceptions_run, out);
+                write_u16(run, out);
+            }
+            i += run;
+        }
+
+        (void)n;
+        assert(encoding.back().parent == n);
+    }
+
+    template <typename Dictionary>
+    static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
+                                 uint32_t* out, size_t n) {
+        uint16_t const* ptr = reinterpret_cast<uint16_t const*>(in);
+        uint32_t header = *ptr++;
+        uint32_t num_exceptions = header & (wide_exceptions - 1);
+        bool wide = header & wide_exceptions;
+        uint8_t const* exceptions = reinterpret_cast<uint8_t const*>(ptr);
+        ptr += num_exceptions * (wide ? 2 : 1);
+
+        for (size_t i = 0; i != n; ++ptr) {
+            uint32_t index = *ptr;
+            uint32_t decoded_ints = 1;
+            if (DS2I_LIKELY(index > EXCEPTIONS - 1)) {
+                decoded_ints = dict.copy(index, out);
+            } else {
+                if (index == exceptions_run) {
+                    decoded_ints = *(++ptr);
+                }
+                if (wide) {
+                    memcpy(out, exceptions, decoded_ints * sizeof(uint32_t));
+                    exceptions += decoded_ints * sizeof(uint32_t);
+                } else {
+                    unpack_u16(exceptions, out, decoded_ints);
+                    exceptions += decoded_ints * sizeof(uint16_t);
+                }
+            }
+            out += decoded_ints;
+            i += decoded_ints;
+        }
+
+        return reinterpret_cast<uint8_t const*>(ptr);
+    }
+
+private:
+    static void write_u16(uint32_t x, std::vector<uint8_t>& out) {
+        assert(x < 65536);
+        auto ptr = reinterpret_cast<uint8_t const*>(&x);
+        out.insert(out.end(), ptr, ptr + 2);
+    }
+
+    static void unpack_u16(uint8_t const* in, uint32_t* out, uint32_t n) {
+        uint16_t const* ptr = reinterpret_cast<uint16_t const*>(in);
+        uint32_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= n; i += 8) {
+            __m128i x =
+                _mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                                _mm256_cvtepu16_epi32(x));
+        }
+#elif defined(__SSE4_1__)
+        for (; i + 4 <= n; i += 4) {
+            __m128i x =
+                _mm_loadl_epi64(reinterpret_cast<__m128i const*>(ptr + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                             _mm_cvtepu16_epi32(x));
+        }
+#endif
+        for (; i != n; ++i) {
+            out[i] = ptr[i];
+        }
+    }
+};
+
+}  // namespace ds2i
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 namespace ds2i {
 
 typedef std::pair<const uint8_t*, const uint8_t*> byte_range;
@@ -78,4 +80,58 @@ uint64_t hash_bytes64(uint32_t const* ptr, size_t size_u32) {
     return murmur_hash64(reinterpret_cast<uint8_t const*>(ptr),
                          size_u32 * sizeof(uint32_t), 0);
 }
+
+// Polynomial hash of a window of integers, finalized so that its low bits
+// can index a power-of-two table. Unlike murmur, the hash of any window of
+// a sequence can be derived from the prefix hashes of the sequence in
+// O(1): see window_hashes.
+struct window_hash {
+    static const uint64_t base = 0x9E3779B97F4A7C15ULL;
+
+    static uint64_t finalize(uint64_t h, uint32_t size) {
+        h ^= size * 0xc6a4a7935bd1e995ULL;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static uint64_t hash(uint32_t const* begin, uint32_t size) {
+        uint64_t h = 0;
+        for (uint32_t i = 0; i != size; ++i) {
+            h = h * base + begin[i];
+        }
+        return finalize(h, size);
+    }
+};
+
+// window_hash of all the windows of [begin, begin + n) of size at most
+// [max_size], computed in a single pass
+struct window_hashes {
+    void compute(uint32_t const* begin, uint64_t n, uint32_t max_size) {
+        m_prefix.resize(n + 1);
+        m_prefix[0] = 0;
+        for (uint64_t i = 0; i != n; ++i) {
+            m_prefix[i + 1] = m_prefix[i] * window_hash::base + begin[i];
+        }
+        m_powers.resize(max_size + 1);
+        m_powers[0] = 1;
+        for (uint32_t i = 0; i != max_size; ++i) {
+            m_powers[i + 1] = m_powers[i] * window_hash::base;
+        }
+    }
+
+    // hash of [begin + i, begin + i + size)
+    uint64_t operator()(uint64_t i, uint32_t size) const {
+        assert(i + size < m_prefix.size() and size < m_powers.size());
+        return window_hash::finalize(
+            m_prefix[i + size] - m_prefix[i] * m_powers[size], size);
+    }
+
+private:
+    std::vector<uint64_t> m_prefix;
+    std::vector<uint64_t> m_powers;
+};
 }  // namespace ds2i
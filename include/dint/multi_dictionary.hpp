@@ -1,12 +1,11 @@
 #pragma once
 
-#include <unordered_map>
 #include <fstream>
 
 #include <succinct/mappable_vector.hpp>
 
 #include "dint_configuration.hpp"
-#include "hash_utils.hpp"
+#include "codeword_table.hpp"
 #include "util.hpp"
 #include "dictionary_building_utils.hpp"
 
@@ -151,7 +150,12 @@ struct multi_dictionary {
 
             {
                 logger() << "creating offsets..." << std::endl;
-                boost::progress_display progress(m_size);
+                std::vector<target_t> all_targets;
+                for (auto const& t : m_targets) {
+                    all_targets.insert(all_targets.end(), t.begin(), t.end());
+                }
+                auto offsets = locate_targets(all_targets, m_table);
+                auto offset_it = offsets.begin();
                 for (uint64_t i = 0; i != num_dictionaries; ++i) {
                     auto& t = m_targets[i];
                     m_start_offsets.push_back(m_offsets.size());
@@ -167,18 +171,10 @@ struct multi_dictionary {
                     }
 
                     for (auto& cur : t) {
-                        auto& entry = cur.entry;
-                        auto found_itr =
-                            std::search(m_table.begin(), m_table.end(),
-                                        entry.begin(), entry.end());
-                        assert(found_itr != m_table.end());
-                        uint32_t entry_size = entry.size();
-                        uint32_t offset =
-                            std::distance(m_table.begin(), found_itr);
+                        uint32_t entry_size = cur.entry.size();
                         uint32_t size_and_offset =
-                            ((entry_size - 1) << 24) | offset;
+                            ((entry_size - 1) << 24) | *offset_it++;
                         m_offsets.push_back(size_and_offset);
-                        ++progress;
                     }
                 }
             }
@@ -191,43 +187,62 @@ struct multi_dictionary {
 
             for (uint32_t dictionary_id = 0; dictionary_id != num_dictionaries;
                  ++dictionary_id) {
-                uint32_t i = EXCEPTIONS;
-                for (uint32_t n = 256; n >= 16; n /= 2, ++i) {
-                    uint64_t hash = hash_bytes64(run.data(), n);
-                    m_maps[dictionary_id][hash] = i;
-                    m_maps[dictionary_id + num_dictionaries][hash] = i;
-                }
+                auto get = [&](uint32_t i) {
+                    return this->get(dictionary_id, i);
+                };
+                auto& map = m_maps[dictionary_id];
+                auto& small_map = m_maps[dictionary_id + num_dictionaries];
 
                 uint32_t n = (dictionary_id + 1 == num_dictionaries
                                   ? m_offsets.size()
                                   : m_start_offsets[dictionary_id + 1]) -
                              m_start_offsets[dictionary_id] - reserved;
+                map.init(n);
+                small_map.init(std::min<uint32_t>(n, 256));
+
+                uint32_t i = EXCEPTIONS;
+                for (uint32_t run_size = 256; run_size >= 16;
+                     run_size /= 2, ++i) {
+                    map.insert(run.data(), run_size, i, get);
+                    small_map.insert(run.data(), run_size, i, get);
+                }
 
                 for (; i < n; ++i) {
-                    uint64_t hash = hash_bytes64(get(dictionary_id, i),
-                                                 size(dictionary_id, i));
-                    m_maps[dictionary_id][hash] = i;
+                    map.insert(get(i), size(dictionary_id, i), i, get);
                     if (i < 256) {
-                        m_maps[dictionary_id + num_dictionaries][hash] = i;
+                        small_map.insert(get(i), size(dictionary_id, i), i,
+                                         get);
                     }
                 }
+
+                if (map.collisions()) {
+                    logger() << map.collisions() << " hash collisions in "
+                             << "dictionary " << dictionary_id << std::endl;
+                }
             }
         }
 
         uint32_t lookup(uint32_t dictionary_id, uint32_t const* begin,
                         uint32_t entry_size, uint32_t log2_num_entries) const {
+            return lookup(dictionary_id, begin, entry_size, log2_num_entries,
+                          window_hash::hash(begin, entry_size));
+        }
+
+        // [hash] is the window_hash of [begin, begin + entry_size)
+        uint32_t lookup(uint32_t dictionary_id, uint32_t const* begin,
+                        uint32_t entry_size, uint32_t log2_num_entries,
+                        uint64_t hash) const {
             assert(log2_num_entries == 8 or log2_num_entries == 16);
             assert(dictionary_id < num_dictionaries);
+            assert(entry_size <= max_entry_size);
 
-            uint64_t hash = hash_bytes64(begin, entry_size);
             auto const& map = m_maps[dictionary_id + (log2_num_entries == 8) *
                                                          num_dictionaries];
-            auto it = map.find(hash);
-            if (it != map.end()) {
-                assert((*it).second < num_entries);
-                return (*it).second;
-            }
-            return invalid_index;
+            uint32_t index =
+                map.find(hash, begin, entry_size,
+                         [&](uint32_t i) { return get(dictionary_id, i); });
+            assert(index == invalid_index or index < num_entries);
+            return index;
         }
 
         void build(multi_dictionary& dict) {
@@ -285,7 +300,9 @@ struct multi_dictionary {
         std::vector<uint32_t> m_offsets;
         std::vector<uint32_t> m_table;
 
-        std::vector<std::unordered_map<uint64_t, uint32_t>> m_maps;
+        // map from entries to table indexes, used during encoding: the last
+        // [num_dictionaries] maps only hold the first 256 entries
+        std::vector<codeword_table> m_maps;
     };
 
     multi_dictionary() {}
@@ -303,6 +320,24 @@ struct multi_dictionary {
         return size;
     }
 
+    // raw access for the vectorized decoder, see dint_block::decode_packed
+    uint32_t const* offsets(uint32_t dictionary_id) const {
+        assert(dictionary_id < num_dictionaries);
+        return m_offsets.data() + m_start_offsets[dictionary_id];
+    }
+
+    uint32_t num_offsets(uint32_t dictionary_id) const {
+        assert(dictionary_id < num_dictionaries);
+        uint32_t end = dictionary_id + 1 == num_dictionaries
+                           ? m_offsets.size()
+                           : m_start_offsets[dictionary_id + 1];
+        return end - m_start_offsets[dictionary_id];
+    }
+
+    uint32_t const* table() const {
+        return m_table.data();
+    }
+
     void swap(multi_dictionary& other) {
         m_start_offsets.swap(other.m_start_offsets);
         m_offsets.swap(other.m_offsets);
@@ -1,12 +1,11 @@
 #pragma once
 
-#include <unordered_map>
 #include <fstream>
 
 #include <succinct/mappable_vector.hpp>
 
 #include "dint_configuration.hpp"
-#include "hash_utils.hpp"
+#include "codeword_table.hpp"
 #include "util.hpp"
 
 namespace ds2i {
@@ -110,26 +109,35 @@ struct rectangular_dictionary {
         void build() {}
 
         void prepare_for_encoding() {
+            auto get = [&](uint32_t i) { return this->get(i); };
+            m_map.init(size());
             std::vector<uint32_t> run(256, 0);
             uint32_t i = EXCEPTIONS;
             for (uint32_t n = 256; n >= 16; n /= 2, ++i) {
-                uint64_t hash = hash_bytes64(run.data(), n);
-                m_map[hash] = i;
+                m_map.insert(run.data(), n, i, get);
             }
             for (; i < size(); ++i) {
-                uint64_t hash = hash_bytes64(get(i), size(i));
-                m_map[hash] = i;
+                m_map.insert(get(i), size(i), i, get);
+            }
+            if (m_map.collisions()) {
+                logger() << m_map.collisions() << " hash collisions"
+                         << std::endl;
             }
         }
 
         uint32_t lookup(uint32_t const* begin, uint32_t entry_size) const {
-            uint64_t hash = hash_bytes64(begin, entry_size);
-            auto it = m_map.find(hash);
-            if (it != m_map.end()) {
-                assert((*it).second < num_entries);
-                return (*it).second;
-            }
-            return invalid_index;
+            return lookup(begin, entry_size,
+                          window_hash::hash(begin, entry_size));
+        }
+
+        // [hash] is the window_hash of [begin, begin + entry_size)
+        uint32_t lookup(uint32_t const* begin, uint32_t entry_size,
+                        uint64_t hash) const {
+            assert(entry_size <= max_entry_size);
+            uint32_t index = m_map.find(hash, begin, entry_size,
+                                        [&](uint32_t i) { return get(i); });
+            assert(index == invalid_index or index < num_entries);
+            return index;
         }
 
         void build(rectangular_dictionary& dict) {
@@ -197,8 +205,8 @@ struct rectangular_dictionary {
         uint32_t m_size;
         std::vector<uint32_t> m_table;
 
-        // map from hash codes to table indexes, used during encoding
-        std::unordered_map<uint64_t, uint32_t> m_map;
+        // map from entries to table indexes, used during encoding
+        codeword_table m_map;
     };
 
     rectangular_dictionary() {}
@@ -1,12 +1,11 @@
 #pragma once
 
-#include <unordered_map>
 #include <fstream>
 
 #include <succinct/mappable_vector.hpp>
 
 #include "dint_configuration.hpp"
-#include "hash_utils.hpp"
+#include "codeword_table.hpp"
 #include "util.hpp"
 #include "dictionary_building_utils.hpp"
 
@@ -137,41 +136,46 @@ struct single_dictionary {
 
             {
                 logger() << "creating offsets..." << std::endl;
-                for (auto& cur : m_targets) {
-                    auto& entry = cur.entry;
-                    auto found_itr = std::search(m_table.begin(), m_table.end(),
-                                                 entry.begin(), entry.end());
-                    assert(found_itr != m_table.end());
-                    uint32_t entry_size = entry.size();
-                    uint32_t offset = std::distance(m_table.begin(), found_itr);
+                auto offsets = locate_targets(m_targets, m_table);
+                for (uint32_t i = 0; i != m_targets.size(); ++i) {
+                    uint32_t entry_size = m_targets[i].entry.size();
                     uint32_t size_and_offset =
-                        ((entry_size - 1) << 24) | offset;
+                        ((entry_size - 1) << 24) | offsets[i];
                     m_offsets.push_back(size_and_offset);
                 }
             }
         }
 
         void prepare_for_encoding() {
+            auto get = [&](uint32_t i) { return this->get(i); };
+            m_map.init(size());
             std::vector<uint32_t> run(256, 0);
             uint32_t i = EXCEPTIONS;
             for (uint32_t n = 256; n >= 16; n /= 2, ++i) {
-                uint64_t hash = hash_bytes64(run.data(), n);
-                m_map[hash] = i;
+                m_map.insert(run.data(), n, i, get);
             }
             for (; i < size(); ++i) {
-                uint64_t hash = hash_bytes64(get(i), size(i));
-                m_map[hash] = i;
+                m_map.insert(get(i), size(i), i, get);
+            }
+            if (m_map.collisions()) {
+                logger() << m_map.collisions() << " hash collisions"
+                         << std::endl;
             }
         }
 
         uint32_t lookup(uint32_t const* begin, uint32_t entry_size) const {
-            uint64_t hash = hash_bytes64(begin, entry_size);
-            auto it = m_map.find(hash);
-            if (it != m_map.end()) {
-                assert((*it).second < num_entries);
-                return (*it).second;
-            }
-            return invalid_index;
+            return lookup(begin, entry_size,
+                          window_hash::hash(begin, entry_size));
+        }
+
+        // [hash] is the window_hash of [begin, begin + entry_size)
+        uint32_t lookup(uint32_t const* begin, uint32_t entry_size,
+                        uint64_t hash) const {
+            assert(entry_size <= max_entry_size);
+            uint32_t index = m_map.find(hash, begin, entry_size,
+                                        [&](uint32_t i) { return get(i); });
+            assert(index == invalid_index or index < num_entries);
+            return index;
         }
 
         void build(single_dictionary& dict) {
@@ -221,8 +225,8 @@ struct single_dictionary {
         std::vector<uint32_t> m_offsets;
         std::vector<uint32_t> m_table;
 
-        // map from hash codes to table indexes, used during encoding
-        std::unordered_map<uint64_t, uint32_t> m_map;
+        // map from entries to table indexes, used during encoding
+        codeword_table m_map;
     };
 
     single_dictionary() {}
@@ -237,6 +241,19 @@ struct single_dictionary {
         return size;
     }
 
+    // raw access for the vectorized decoder, see dint_block::decode_packed
+    uint32_t const* offsets() const {
+        return m_offsets.data();
+    }
+
+    uint32_t num_offsets() const {
+        return m_offsets.size();
+    }
+
+    uint32_t const* table() const {
+        return m_table.data();
+    }
+
     void swap(single_dictionary& other) {
         m_offsets.swap(other.m_offsets);
         m_table.swap(other.m_table);
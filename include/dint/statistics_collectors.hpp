@@ -1,7 +1,13 @@
 #pragma once
 
+#include <vector>
+#include <algorithm>
+#include <limits>
+
 #include "hash_utils.hpp"
 #include "dint_configuration.hpp"
+#include "configuration.hpp"
+#include "util.hpp"
 
 namespace ds2i {
 
@@ -16,7 +22,310 @@ struct block_type {
     std::vector<uint32_t> data;
 };
 
-typedef std::unordered_map<uint64_t, block_type> map_type;
+// Open-addressing map from blocks of at most constants::max_entry_size
+// integers to their frequencies. Entries and blocks are stored in flat
+// arrays, so no allocation is done per entry. The map is split by hash into
+// [num_parts] tables, so that the maps filled by different threads can be
+// merged part by part in parallel.
+struct block_table {
+    block_table(size_t num_parts = 1) : m_parts(num_parts) {}
+
+    void increase(uint32_t const* entry, uint32_t n, uint64_t amount) {
+        uint64_t hash = window_hash::hash(entry, n);
+        m_parts[part(hash)].increase(hash, entry, n, amount);
+    }
+
+    // adds the frequencies of the entries in the p-th part of [other]
+    void merge_part(block_table const& other, size_t p) {
+        assert(other.num_parts() == num_parts());
+        auto const& from = other.m_parts[p];
+        for (auto const& e : from.entries) {
+            m_parts[p].increase(e.hash, &from.data[e.offset], e.size, e.freq);
+        }
+    }
+
+    // calls visit(freq, data, size) for each entry
+    template <typename Visitor>
+    void for_each(Visitor visit) const {
+        for (auto const& part : m_parts) {
+            for (auto const& e : part.entries) {
+                visit(e.freq, &part.data[e.offset], e.size);
+            }
+        }
+    }
+
+    size_t num_parts() const {
+        return m_parts.size();
+    }
+
+    size_t size() const {
+        size_t s = 0;
+        for (auto const& part : m_parts) s += part.entries.size();
+        return s;
+    }
+
+private:
+    size_t part(uint64_t hash) const {
+        return (hash >> 32) % m_parts.size();
+    }
+
+    // NOTE: the data of a part can pass 2^32 integers on large
+    // collections, so the offsets take 56 bits
+    struct entry_type {
+        uint64_t hash;
+        uint64_t freq;
+        uint64_t offset : 56;  // in data
+        uint64_t size : 8;
+    };
+
+    struct table {
+        // slots hold 1 + the position of the entry in entries, 0 if empty
+        std::vector<uint32_t> slots;
+        std::vector<entry_type> entries;
+        std::vector<uint32_t> data;
+
+        void increase(uint64_t hash, uint32_t const* entry, uint32_t n,
+                      uint64_t amount) {
+            assert(n > 0 and n <= constants::max_entry_size);
+            // the slots hold 32-bit positions
+            assert(entries.size() < std::numeric_limits<uint32_t>::max());
+            if (2 * (entries.size() + 1) > slots.size()) grow();
+            uint64_t mask = slots.size() - 1;
+            for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+                if (!slots[i]) {
+                    entries.push_back({hash, amount, data.size(), n});
+                    data.insert(data.end(), entry, entry + n);
+                    slots[i] = entries.size();
+                    return;
+                }
+                auto& e = entries[slots[i] - 1];
+                if (e.hash == hash and e.size == n and
+                    std::equal(entry, entry + n, &data[e.offset])) {
+                    e.freq += amount;
+                    return;
+                }
+            }
+        }
+
+        void grow() {
+            slots.assign(std::max<size_t>(1024, 2 * slots.size()), 0);
+            uint64_t mask = slots.size() - 1;
+            for (uint32_t id = 0; id != entries.size(); ++id) {
+                uint64_t i = entries[id].hash & mask;
+                while (slots[i]) i = (i + 1) & mask;
+                slots[i] = id + 1;
+            }
+        }
+    };
+
+    std::vector<table> m_parts;
+};
+
+// Approximate, memory-bounded alternative to block_table. Each part keeps a
+// count-min sketch (with conservative update) of the frequencies of all the
+// blocks plus a bounded table of candidate heavy hitters: a block enters the
+// table when its estimated frequency reaches the admission threshold and,
+// when the table is full, the half with the lowest estimates is evicted and
+// the threshold raised. Since the sketch keeps counting evicted blocks, a
+// block that becomes frequent later re-enters with its whole count.
+// Reported frequencies are the sketch estimates, thus never lower than the
+// exact ones. Half of the [bytes] is used by the sketches and half by the
+// candidate tables.
+struct heavy_hitters_table {
+    heavy_hitters_table(size_t num_parts = 1, uint64_t bytes = uint64_t(1)
+                                                               << 30)
+        : m_parts(num_parts, part_type(bytes / num_parts)) {}
+
+    void increase(uint32_t const* entry, uint32_t n, uint64_t amount) {
+        uint64_t hash = window_hash::hash(entry, n);
+        m_parts[part(hash)].increase(hash, entry, n, amount);
+    }
+
+    // adds the sketch and the candidates of the p-th part of [other]
+    void merge_part(heavy_hitters_table const& other, size_t p) {
+        assert(other.num_parts() == num_parts());
+        m_parts[p].merge(other.m_parts[p]);
+    }
+
+    // calls visit(freq, data, size) for each candidate
+    template <typename Visitor>
+    void for_each(Visitor visit) const {
+        for (auto const& part : m_parts) {
+            for (auto const& e : part.entries) {
+                visit(part.estimate(e.hash), &part.data[e.offset], e.size);
+            }
+        }
+    }
+
+    size_t num_parts() const {
+        return m_parts.size();
+    }
+
+    size_t size() const {
+        size_t s = 0;
+        for (auto const& part : m_parts) s += part.entries.size();
+        return s;
+    }
+
+    // maximum number of candidates kept
+    size_t capacity() const {
+        size_t c = 0;
+        for (auto const& part : m_parts) c += part.capacity;
+        return c;
+    }
+
+private:
+    size_t part(uint64_t hash) const {
+        return (hash >> 32) % m_parts.size();
+    }
+
+    struct entry_type {
+        uint64_t hash;
+        uint64_t freq;
+        uint32_t offset;  // in data
+        uint32_t size;
+    };
+
+    struct part_type {
+        static const uint32_t depth = 4;
+        static const uint64_t bytes_per_candidate =
+            sizeof(entry_type) + constants::max_entry_size * sizeof(uint32_t) +
+            4 * sizeof(uint32_t);
+
+        part_type(uint64_t bytes) : threshold(1) {
+            uint64_t log2_width = 10;
+            while ((depth * sizeof(uint64_t) << (log2_width + 1)) <= bytes / 2) {
+                ++log2_width;
+            }
+            shift = 64 - log2_width;
+            sketch.assign(depth << log2_width, 0);
+            capacity = std::max<uint64_t>(1024, bytes / 2 / bytes_per_candidate);
+            slots.assign(uint64_t(1) << ceil_log2(2 * capacity), 0);
+        }
+
+        // rows are indexed with independent multiplicative hashes
+        uint64_t position(uint64_t hash, uint32_t row) const {
+            static const uint64_t multipliers[depth] = {
+                0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+                0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+            return (uint64_t(row) << (64 - shift)) +
+                   ((hash * multipliers[row]) >> shift);
+        }
+
+        uint64_t estimate(uint64_t hash) const {
+            uint64_t freq = sketch[position(hash, 0)];
+            for (uint32_t r = 1; r != depth; ++r) {
+                freq = std::min(freq, sketch[position(hash, r)]);
+            }
+            return freq;
+        }
+
+        void increase(uint64_t hash, uint32_t const* entry, uint32_t n,
+                      uint64_t amount) {
+            uint64_t freq = estimate(hash) + amount;
+            for (uint32_t r = 0; r != depth; ++r) {
+                uint64_t& counter = sketch[position(hash, r)];
+                counter = std::max(counter, freq);
+            }
+            update(hash, entry, n, freq);
+        }
+
+        void merge(part_type const& other) {
+            assert(sketch.size() == other.sketch.size());
+            for (uint64_t i = 0; i != sketch.size(); ++i) {
+                sketch[i] += other.sketch[i];
+            }
+            for (auto const& e : other.entries) {
+                update(e.hash, &other.data[e.offset], e.size,
+                       estimate(e.hash));
+            }
+        }
+
+        // sets the frequency of the candidate, admitting it if needed
+        void update(uint64_t hash, uint32_t const* entry, uint32_t n,
+                    uint64_t freq) {
+            assert(n > 0 and n <= constants::max_entry_size);
+            uint64_t mask = slots.size() - 1;
+            uint64_t i = hash & mask;
+            for (; slots[i]; i = (i + 1) & mask) {
+                auto& e = entries[slots[i] - 1];
+                if (e.hash == hash and e.size == n and
+                    std::equal(entry, entry + n, &data[e.offset])) {
+                    e.freq = freq;
+                    return;
+                }
+            }
+            if (freq < threshold) return;
+            if (entries.empty()) {
+                entries.reserve(capacity + 1);
+                data.reserve((capacity + 1) * constants::max_entry_size);
+            }
+            entries.push_back({hash, freq, uint32_t(data.size()), n});
+            data.insert(data.end(), entry, entry + n);
+            slots[i] = entries.size();
+            if (entries.size() > capacity) prune();
+        }
+
+        // keeps the candidates whose estimate is above the median and, up
+        // to half the capacity, some of those tied with it: when many
+        // estimates are tied at the top, keeping only those above the
+        // median would evict the heaviest candidates
+        void prune() {
+            std::vector<uint64_t> freqs;
+            freqs.reserve(entries.size());
+            for (auto& e : entries) {
+                e.freq = estimate(e.hash);
+                freqs.push_back(e.freq);
+            }
+            auto median_it = freqs.begin() + freqs.size() / 2;
+            std::nth_element(freqs.begin(), median_it, freqs.end(),
+                             std::greater<uint64_t>());
+            uint64_t median = *median_it;
+            threshold = std::max(threshold, median);
+
+            uint64_t above = std::count_if(
+                freqs.begin(), median_it,
+                [&](uint64_t freq) { return freq > median; });
+            uint64_t ties = capacity / 2 > above ? capacity / 2 - above : 0;
+
+            uint64_t kept = 0, offset = 0;
+            for (auto const& e : entries) {
+                if (e.freq < median) continue;
+                if (e.freq == median) {
+                    if (!ties) continue;
+                    --ties;
+                }
+                std::copy(&data[e.offset], &data[e.offset] + e.size,
+                          &data[offset]);
+                entries[kept++] = {e.hash, e.freq, uint32_t(offset), e.size};
+                offset += e.size;
+            }
+            entries.resize(kept);
+            data.resize(offset);
+
+            std::fill(slots.begin(), slots.end(), 0);
+            uint64_t mask = slots.size() - 1;
+            for (uint32_t id = 0; id != entries.size(); ++id) {
+                uint64_t i = entries[id].hash & mask;
+                while (slots[i]) i = (i + 1) & mask;
+                slots[i] = id + 1;
+            }
+        }
+
+        std::vector<uint64_t> sketch;  // depth rows
+        uint64_t shift;
+        uint64_t capacity;
+        uint64_t threshold;  // minimum estimate to be admitted
+        // slots hold 1 + the position of the entry in entries, 0 if empty
+        std::vector<uint32_t> slots;
+        std::vector<entry_type> entries;
+        std::vector<uint32_t> data;
+    };
+
+    std::vector<part_type> m_parts;
+};
+
+typedef block_table map_type;
 
 struct selector {
     uint32_t get(uint32_t const* entry, size_t n) {
@@ -57,36 +366,39 @@ struct length_freq_sorter {
 struct freq_length_sorter {
     bool operator()(block_type const& l, block_type const& r) {
         if (l.freq == r.freq) {
+            if (l.data.size() == r.data.size()) {
+                // NOTE: break ties so that the order does not depend on how
+                // the statistics were collected
+                return l.data < r.data;
+            }
             return l.data.size() > r.data.size();
         }
         return l.freq > r.freq;
     }
 };
 
-void increase_frequency(uint32_t const* entry, size_t n, map_type& bmap,
+template <typename Map>
+void increase_frequency(uint32_t const* entry, size_t n, Map& bmap,
                         uint32_t amount = 1) {
-    auto hash = hash_bytes64(entry, n);
-    auto it = bmap.find(hash);
-    if (it != bmap.end()) {
-        (*it).second.freq += amount;
-    } else {
-        block_type block;
-        block.data.reserve(n);
-        while (block.data.size() < n) {
-            block.data.push_back(*entry++);
-        }
-        bmap[hash] = std::move(block);
-    }
+    bmap.increase(entry, n, amount);
 }
 
-template <uint32_t t_max_block_size>
+template <uint32_t t_max_block_size, typename Map = map_type>
 struct adjusted {
     static const uint32_t max_block_size = t_max_block_size;
+    static const bool exact = true;
+    typedef Map map_type;
 
     static std::string type() {
         return "adjusted";
     }
 
+    // [num_maps] maps, each split into a part per thread
+    static std::vector<map_type> create_maps(size_t num_maps,
+                                             size_t num_threads) {
+        return std::vector<map_type>(num_maps, map_type(num_threads));
+    }
+
     static void collect(std::vector<uint32_t>& buf,
                         std::vector<map_type>& block_maps) {
         auto b = buf.data();
@@ -117,4 +429,30 @@ struct adjusted {
         }
     }
 };
+
+// Collects the same blocks as adjusted, but into heavy_hitters_tables
+// that, all together, fit in configuration::stats_memory_mb megabytes
+// (DS2I_STATS_MEMORY_MB).
+template <uint32_t t_max_block_size>
+struct approximate : adjusted<t_max_block_size, heavy_hitters_table> {
+    static const bool exact = false;
+    typedef heavy_hitters_table map_type;
+
+    static std::string type() {
+        return "approximate-" +
+               std::to_string(configuration::get().stats_memory_mb) + "MB";
+    }
+
+    static std::vector<map_type> create_maps(size_t num_maps,
+                                             size_t num_threads) {
+        // NOTE: each thread fills its own copy of the maps, which are then
+        // merged into the returned ones
+        uint64_t bytes = uint64_t(configuration::get().stats_memory_mb) << 20;
+        bytes /= num_maps * (num_threads + 1);
+        std::vector<map_type> maps(num_maps, map_type(num_threads, bytes));
+        logger() << "keeping at most " << maps.front().capacity()
+                 << " candidates per map" << std::endl;
+        return maps;
+    }
+};
 };  // namespace ds2i
@@ -4,7 +4,8 @@
 #include <succinct/bit_vector.hpp>
 #include "compact_elias_fano.hpp"
 #include "block_posting_list.hpp"
-#include "semiasync_queue.hpp"
+#include "ordered_job_queue.hpp"
+#include "byte_arena.hpp"
 
 namespace ds2i {
 
@@ -18,8 +19,7 @@ namespace ds2i {
         class builder {
         public:
             builder(uint64_t num_docs, global_parameters const& params)
-                : m_queue(1 << 24)
-                , m_params(params)
+                : m_params(params)
             {
                 m_num_docs = num_docs;
                 m_endpoints.push_back(0);
@@ -30,42 +30,51 @@ namespace ds2i {
                                   FreqsIterator freqs_begin, uint64_t /* occurrences */)
             {
                 if (!n) throw std::invalid_argument("List must be nonempty");
-                block_posting_list<BlockCodec, Profile>::write(m_lists, n,
-                                                               docs_begin, freqs_begin);
-                m_endpoints.push_back(m_lists.size());
-
-                // if (!n) throw std::invalid_argument("List must be nonempty");
-                // std::shared_ptr<list_adder<DocsIterator, FreqsIterator>>
-                //     ptr(new list_adder<DocsIterator, FreqsIterator>
-                //         (*this, docs_begin, freqs_begin, n));
-                // m_queue.add_job(ptr, 2 * n);
+                std::shared_ptr<list_adder<DocsIterator, FreqsIterator>>
+                    ptr(new list_adder<DocsIterator, FreqsIterator>
+                        (*this, docs_begin, freqs_begin, n));
+                m_queue.add_job(ptr, 2 * n);
             }
 
             template <typename BlockDataRange>
             void add_posting_list(uint64_t n, BlockDataRange const& blocks)
             {
                 if (!n) throw std::invalid_argument("List must be nonempty");
-                block_posting_list<BlockCodec>::write_blocks(m_lists, n, blocks);
+                m_queue.complete(); // keep the lists in order
+                std::vector<uint8_t> list;
+                block_posting_list<BlockCodec>::write_blocks(list, n, blocks);
+                m_lists.append(std::move(list));
                 m_endpoints.push_back(m_lists.size());
             }
 
             template <typename BytesRange>
             void add_posting_list(BytesRange const& data)
             {
-                m_lists.insert(m_lists.end(), std::begin(data), std::end(data));
+                m_queue.complete(); // keep the lists in order
+                m_lists.append(std::begin(data), std::end(data));
                 m_endpoints.push_back(m_lists.size());
             }
 
             void build_model(std::string const&)
             {}
 
+            // Writes the lists to [filename] as they are committed, keeping
+            // at most about DS2I_BUILD_MEMORY_MB of them in memory; the
+            // lists of the index built are mapped from the file, which is
+            // removed with the builder.
+            void spill_lists_to(std::string const& filename)
+            {
+                m_lists.spill_to(filename,
+                                 uint64_t(configuration::get().build_memory_mb) << 20);
+            }
+
             void build(block_freq_index& sq)
             {
                 m_queue.complete();
                 sq.m_params = m_params;
                 sq.m_size = m_endpoints.size() - 1;
                 sq.m_num_docs = m_num_docs;
-                sq.m_lists.steal(m_lists);
+                m_lists.release(sq.m_lists);
 
                 succinct::bit_vector_builder bvb;
                 compact_elias_fano::write(bvb, m_endpoints.begin(),
@@ -77,7 +86,7 @@ namespace ds2i {
         private:
 
             template <typename DocsIterator, typename FreqsIterator>
-            struct list_adder : semiasync_queue::job {
+            struct list_adder : ordered_job_queue::job {
                 list_adder(builder& b,
                            DocsIterator docs_begin,
                            FreqsIterator freqs_begin,
@@ -97,7 +106,7 @@ namespace ds2i {
 
                 virtual void commit()
                 {
-                    b.m_lists.insert(b.m_lists.end(), list.begin(), list.end());
+                    b.m_lists.append(std::move(list));
                     b.m_endpoints.push_back(b.m_lists.size());
                 }
 
@@ -108,11 +117,11 @@ namespace ds2i {
                 std::vector<uint8_t> list;
             };
 
-            semiasync_queue m_queue;
+            ordered_job_queue m_queue;
             global_parameters m_params;
             size_t m_num_docs;
             std::vector<uint64_t> m_endpoints;
-            std::vector<uint8_t> m_lists;
+            byte_arena m_lists;
         };
 
         size_t size() const
@@ -4,6 +4,7 @@
 #include "block_codecs.hpp"
 #include "util.hpp"
 #include "block_profiler.hpp"
+#include "search_utils.hpp"
 
 namespace ds2i {
 
@@ -92,6 +93,7 @@ namespace ds2i {
                 , m_block_endpoints(m_block_maxs + 4 * m_blocks)
                 , m_blocks_data(m_block_endpoints + 4 * (m_blocks - 1))
                 , m_universe(universe)
+                , m_docids(BlockCodec::block_size)
             {
                 if (Profile) {
                     // std::cout << "OPEN\t" << m_term_id << "\t" << m_blocks << "\n";
@@ -125,22 +127,35 @@ namespace ds2i {
             {
                 assert(lower_bound >= m_cur_docid || position() == 0);
                 if (DS2I_UNLIKELY(lower_bound > m_cur_block_max)) {
-                    // binary search seems to perform worse here
                     if (lower_bound > block_max(m_blocks - 1)) {
                         m_cur_docid = m_universe;
                         return;
                     }
 
-                    uint64_t block = m_cur_block + 1;
-                    while (block_max(block) < lower_bound) {
-                        ++block;
-                    }
-
+                    // NOTE: the next block is the most likely target, so
+                    // the maxima are scanned linearly before galloping
+                    uint64_t block = search_geq(block_maxs(), m_cur_block + 1,
+                                                m_blocks, lower_bound);
                     decode_docs_block(block);
                 }
 
-                while (docid() < lower_bound) {
-                    m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                if (docid() < lower_bound) {
+                    // most skips within a block are short, so the next
+                    // docid is tried before searching the docids of the block
+                    uint32_t next_docid =
+                        m_cur_docid + m_docs_buf[m_pos_in_block + 1] + 1;
+                    if (next_docid >= lower_bound) {
+                        ++m_pos_in_block;
+                        m_cur_docid = next_docid;
+                    } else {
+                        uint32_t const* docids =
+                            m_docids.get(m_docs_buf.data(), m_pos_in_block,
+                                         m_cur_block_size, m_cur_docid);
+                        m_pos_in_block =
+                            search_geq(docids, m_pos_in_block + 2,
+                                       m_cur_block_size, lower_bound);
+                        m_cur_docid = docids[m_pos_in_block];
+                    }
                     assert(m_pos_in_block < m_cur_block_size);
                 }
             }
@@ -152,9 +167,65 @@ namespace ds2i {
                 if (DS2I_UNLIKELY(block != m_cur_block)) {
                     decode_docs_block(block);
                 }
-                while (position() < pos) {
-                    m_cur_docid += m_docs_buf[++m_pos_in_block] + 1;
+                if (position() < pos) {
+                    uint32_t const* docids =
+                        m_docids.get(m_docs_buf.data(), m_pos_in_block,
+                                     m_cur_block_size, m_cur_docid);
+                    m_pos_in_block = pos % BlockCodec::block_size;
+                    m_cur_docid = docids[m_pos_in_block];
+                }
+            }
+
+            // Hints that next_geq(lower_bound) is coming: prefetches the
+            // beginning of the block it will decode, so that the cache
+            // misses on several lists can be overlapped.
+            void DS2I_ALWAYSINLINE prefetch_geq(uint64_t lower_bound) const
+            {
+                if (lower_bound <= m_cur_block_max or
+                    lower_bound > block_max(m_blocks - 1)) {
+                    return;
+                }
+                uint64_t block = search_geq(block_maxs(), m_cur_block + 1,
+                                            m_blocks, lower_bound);
+                uint8_t const* block_data = m_blocks_data +
+                    ((uint32_t const*)m_block_endpoints)[block - 1];
+                for (uint64_t i = 0; i != prefetch_lines; ++i) {
+                    succinct::intrinsics::prefetch(block_data + 64 * i);
+                }
+            }
+
+            static const uint64_t max_block_size = BlockCodec::block_size;
+
+            // Writes the docids and frequencies of the postings from the
+            // current one to the end of its block to [docids] and [freqs],
+            // which must have room for max_block_size values, and moves to
+            // the first posting of the next block. Returns the number of
+            // postings written, 0 at the end of the list.
+            uint64_t next_block(uint32_t* docids, uint32_t* freqs)
+            {
+                if (DS2I_UNLIKELY(m_cur_docid == m_universe)) {
+                    return 0;
+                }
+                if (!m_freqs_decoded) {
+                    decode_freqs_block();
                 }
+
+                uint32_t pos = m_pos_in_block;
+                uint64_t n = m_cur_block_size - pos;
+                docids[0] = m_cur_docid;
+                prefix_sum_gaps(&m_docs_buf[pos + 1], docids + 1, n - 1,
+                                m_cur_docid + 1);
+                for (uint64_t i = 0; i != n; ++i) {
+                    freqs[i] = m_freqs_buf[pos + i] + 1;
+                }
+
+                if (m_cur_block + 1 == m_blocks) {
+                    m_pos_in_block = m_cur_block_size;
+                    m_cur_docid = m_universe;
+                } else {
+                    decode_docs_block(m_cur_block + 1);
+                }
+                return n;
             }
 
             uint64_t docid() const
@@ -284,9 +355,17 @@ namespace ds2i {
             }
 
         private:
+            // cache lines prefetched by prefetch_geq()
+            static const uint64_t prefetch_lines = 4;
+
+            uint32_t const* block_maxs() const
+            {
+                return (uint32_t const*)m_block_maxs;
+            }
+
             uint32_t block_max(uint32_t block) const
             {
-                return ((uint32_t const*)m_block_maxs)[block];
+                return block_maxs()[block];
             }
 
             void DS2I_NOINLINE decode_docs_block(uint64_t block)
@@ -308,6 +387,7 @@ namespace ds2i {
                 succinct::intrinsics::prefetch(m_freqs_block_data);
 
                 m_docs_buf[0] += cur_base;
+                m_docids.invalidate();
 
                 m_cur_block = block;
                 m_pos_in_block = 0;
@@ -349,6 +429,7 @@ namespace ds2i {
 
             std::vector<uint32_t> m_docs_buf;
             std::vector<uint32_t> m_freqs_buf;
+            block_docids m_docids;
 
             block_profiler::counter_type* m_block_profile;
         };
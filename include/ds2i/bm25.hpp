@@ -5,6 +5,9 @@
 namespace ds2i {
 
     struct bm25 {
+        // identifies the scorer of the wand data files
+        static const uint64_t wand_data_tag = 1;
+
         static constexpr float b = 0.5;
         static constexpr float k1 = 1.2;
 
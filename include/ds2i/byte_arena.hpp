@@ -0,0 +1,184 @@
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <stdexcept>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <succinct/mapper.hpp>
+
+namespace ds2i {
+
+    // Append-only sequence of bytes, stored in chunks that are never moved
+    // once written. Growing a std::vector to a few GB copies its content at
+    // each reallocation and needs up to three times its size meanwhile;
+    // with the chunks, only the bytes appended and the unused tail of the
+    // last chunk take memory, and they are copied once, by release().
+    //
+    // After spill_to(), the chunks are written to a file whenever they
+    // take more than a given amount of memory, and release() maps the
+    // bytes from there instead of copying them.
+    class byte_arena {
+    public:
+        static const uint64_t default_chunk_size = uint64_t(1) << 26;
+
+        byte_arena(uint64_t chunk_size = default_chunk_size)
+            : m_chunk_size(chunk_size)
+            , m_size(0)
+            , m_max_memory(0)
+            , m_memory(0)
+        {}
+
+        ~byte_arena()
+        {
+            if (!m_filename.empty()) {
+                m_file.close();
+                m_mapping.close();
+                std::remove(m_filename.c_str());
+            }
+        }
+
+        byte_arena(byte_arena const&) = delete;
+        byte_arena& operator=(byte_arena const&) = delete;
+
+        // Writes the bytes to [filename], which is removed when the arena is
+        // destroyed, keeping at most about [max_memory] of them in memory;
+        // the arena must be empty.
+        void spill_to(std::string const& filename, uint64_t max_memory)
+        {
+            if (m_size or !m_filename.empty()) {
+                throw std::logic_error("The arena must be empty to spill");
+            }
+            m_file.open(filename, std::ios::binary | std::ios::trunc);
+            if (!m_file) {
+                throw std::runtime_error("Cannot open " + filename);
+            }
+            m_filename = filename;
+            m_max_memory = max_memory;
+            // the file is the image of a frozen mappable_vector<uint8_t>, so
+            // that it can be mapped: the freezing flags and the size, which
+            // is written by release(), precede the bytes
+            uint64_t header[2] = {0, 0};
+            m_file.write(reinterpret_cast<char const*>(header), sizeof(header));
+        }
+
+        uint64_t size() const
+        {
+            return m_size;
+        }
+
+        template <typename Iterator>
+        void append(Iterator begin, Iterator end)
+        {
+            uint64_t n = std::distance(begin, end);
+            if (m_chunks.empty() or
+                m_chunks.back().capacity() - m_chunks.back().size() < n) {
+                m_chunks.emplace_back();
+                m_chunks.back().reserve(std::max(n, m_chunk_size));
+            }
+            m_chunks.back().insert(m_chunks.back().end(), begin, end);
+            m_size += n;
+            m_memory += n;
+            spill_if_needed();
+        }
+
+        // Takes [bytes] as a chunk of its own when it would fill at least
+        // half a chunk, so that large buffers are not copied.
+        void append(std::vector<uint8_t>&& bytes)
+        {
+            if (bytes.size() < m_chunk_size / 2) {
+                append(bytes.begin(), bytes.end());
+                return;
+            }
+            m_size += bytes.size();
+            m_memory += bytes.size();
+            m_chunks.push_back(std::move(bytes));
+            spill_if_needed();
+        }
+
+        // Moves the bytes to [out], freeing each chunk as soon as it has
+        // been copied, and empties the arena; not available after
+        // spill_to().
+        void release(std::vector<uint8_t>& out)
+        {
+            if (!m_filename.empty()) {
+                throw std::logic_error("The bytes have been spilled");
+            }
+            std::vector<uint8_t> bytes;
+            if (m_chunks.size() == 1) {
+                bytes.swap(m_chunks.front());
+                // the chunk was reserved whole, which is wasted on the
+                // indexes smaller than a chunk
+                bytes.shrink_to_fit();
+            } else {
+                bytes.reserve(m_size);
+                for (auto& chunk: m_chunks) {
+                    bytes.insert(bytes.end(), chunk.begin(), chunk.end());
+                    std::vector<uint8_t>().swap(chunk);
+                }
+            }
+            m_chunks.clear();
+            m_size = 0;
+            m_memory = 0;
+            out.swap(bytes);
+        }
+
+        // Moves the bytes to [out]: after spill_to(), [out] is mapped from
+        // the file, so it is valid as long as the arena.
+        void release(succinct::mapper::mappable_vector<uint8_t>& out)
+        {
+            if (m_filename.empty()) {
+                std::vector<uint8_t> bytes;
+                release(bytes);
+                out.steal(bytes);
+                return;
+            }
+
+            spill();
+            m_file.seekp(sizeof(uint64_t));
+            m_file.write(reinterpret_cast<char const*>(&m_size),
+                         sizeof(m_size));
+            m_file.close();
+            if (!m_file) {
+                throw std::runtime_error("Cannot write " + m_filename);
+            }
+            m_mapping.open(m_filename);
+            succinct::mapper::map(out, m_mapping.data());
+        }
+
+    private:
+        void spill_if_needed()
+        {
+            if (!m_filename.empty() and m_memory > m_max_memory) {
+                spill();
+            }
+        }
+
+        void spill()
+        {
+            for (auto& chunk: m_chunks) {
+                m_file.write(reinterpret_cast<char const*>(chunk.data()),
+                             chunk.size());
+            }
+            if (!m_file) {
+                throw std::runtime_error("Cannot write " + m_filename);
+            }
+            m_chunks.clear();
+            m_memory = 0;
+        }
+
+        uint64_t m_chunk_size;
+        uint64_t m_size;
+        std::vector<std::vector<uint8_t>> m_chunks;
+
+        std::string m_filename;
+        uint64_t m_max_memory;
+        uint64_t m_memory; // bytes in the chunks
+        std::ofstream m_file;
+        boost::iostreams::mapped_file_source m_mapping;
+    };
+
+}
@@ -20,6 +20,9 @@ namespace ds2i {
 
         size_t log_partition_size;
         size_t worker_threads;
+        size_t stats_memory_mb;
+        size_t build_memory_mb;
+        size_t prefetch_distance;
 
         bool heuristic_greedy;
 
@@ -31,6 +34,9 @@ namespace ds2i {
             fillvar("DS2I_FIXCOST", fix_cost, 64);
             fillvar("DS2I_LOG_PART", log_partition_size, 7);
             fillvar("DS2I_THREADS", worker_threads, std::thread::hardware_concurrency());
+            fillvar("DS2I_STATS_MEMORY_MB", stats_memory_mb, 4096);
+            fillvar("DS2I_BUILD_MEMORY_MB", build_memory_mb, 1024);
+            fillvar("DS2I_PREFETCH_DISTANCE", prefetch_distance, 0);
             fillvar("DS2I_HEURISTIC_GREEDY", heuristic_greedy, false);
         }
 
@@ -4,7 +4,7 @@
 #include "compact_elias_fano.hpp"
 #include "integer_codes.hpp"
 #include "global_parameters.hpp"
-#include "semiasync_queue.hpp"
+#include "ordered_job_queue.hpp"
 
 namespace ds2i {
 
@@ -16,8 +16,7 @@ public:
     class builder {
     public:
         builder(uint64_t num_docs, global_parameters const& params)
-            : m_queue(1 << 24)
-            , m_params(params)
+            : m_params(params)
             , m_num_docs(num_docs)
             , m_docs_sequences(params)
             , m_freqs_sequences(params) {}
@@ -35,6 +34,11 @@ public:
 
         void build_model(std::string const&) {}
 
+        void spill_lists_to(std::string const&) {
+            throw std::invalid_argument(
+                "The lists of this index type cannot be built on disk");
+        }
+
         void build(freq_index& sq) {
             m_queue.complete();
             sq.m_num_docs = m_num_docs;
@@ -46,7 +50,7 @@ public:
 
     private:
         template <typename DocsIterator, typename FreqsIterator>
-        struct list_adder : semiasync_queue::job {
+        struct list_adder : ordered_job_queue::job {
             list_adder(builder& b, DocsIterator docs_begin,
                        FreqsIterator freqs_begin, uint64_t occurrences,
                        uint64_t n)
@@ -83,7 +87,7 @@ public:
             succinct::bit_vector_builder freqs_bits;
         };
 
-        semiasync_queue m_queue;
+        ordered_job_queue m_queue;
         global_parameters m_params;
         uint64_t m_num_docs;
         bitvector_collection::builder m_docs_sequences;
@@ -123,6 +127,26 @@ public:
             m_cur_docid = val.second;
         }
 
+        // The sequences are not split in blocks that can be located
+        // without moving the enumerator, so there is nothing to prefetch.
+        void prefetch_geq(uint64_t /* lower_bound */) const {}
+
+        static const uint64_t max_block_size = 128;
+
+        // Writes the docids and frequencies of the next (at most)
+        // max_block_size postings to [docids] and [freqs] and moves past
+        // them. Returns the number of postings written, 0 at the end of the
+        // list.
+        uint64_t next_block(uint32_t* docids, uint32_t* freqs) {
+            uint64_t n = 0;
+            for (; n != max_block_size and position() != size(); ++n) {
+                docids[n] = docid();
+                freqs[n] = freq();
+                next();
+            }
+            return n;
+        }
+
         uint64_t docid() const {
             return m_cur_docid;
         }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+
+#include "configuration.hpp"
+
+namespace ds2i {
+
+    // When the second shortest list is at least this many times longer
+    // than the shortest one, intersect() drives the intersection with the
+    // shortest list.
+    static const uint64_t skewed_intersection_ratio = 32;
+
+    // Calls f(docid) for each docid below [end] that is in all the lists;
+    // the enumerators must be sorted by increasing frequency. Each list
+    // skips to the docid of the list that mismatched last, so that all of
+    // them jump over the regions the others do not have.
+    template <typename Enum, typename Function>
+    uint64_t leapfrog_intersect(std::vector<Enum>& enums, uint64_t end,
+                                Function&& f)
+    {
+        uint64_t results = 0;
+        uint64_t candidate = enums[0].docid();
+        size_t i = 1;
+        while (candidate < end) {
+            for (; i < enums.size(); ++i) {
+                enums[i].next_geq(candidate);
+                if (enums[i].docid() != candidate) {
+                    candidate = enums[i].docid();
+                    i = 0;
+                    break;
+                }
+            }
+
+            if (i == enums.size()) {
+                results += 1;
+                f(candidate);
+                enums[0].next();
+                candidate = enums[0].docid();
+                i = 1;
+            }
+        }
+
+        return results;
+    }
+
+    // skewed_intersect() prefetching with [ahead] the blocks of the
+    // candidate [distance] positions later, unless [ahead] is null
+    template <typename Enum, typename Function>
+    uint64_t skewed_intersect(std::vector<Enum>& enums, uint64_t end,
+                              Function&& f, Enum* ahead, uint64_t distance)
+    {
+        auto prefetch_next = [&]() {
+            if (ahead->docid() < end) {
+                ahead->next();
+                for (size_t i = 1; i < enums.size(); ++i) {
+                    enums[i].prefetch_geq(ahead->docid());
+                }
+            }
+        };
+        for (uint64_t k = 0; k != distance; ++k) {
+            prefetch_next();
+        }
+
+        uint64_t results = 0;
+        for (uint64_t candidate = enums[0].docid(); candidate < end;
+             enums[0].next(), candidate = enums[0].docid()) {
+            if (ahead) {
+                prefetch_next();
+            }
+
+            size_t i = 1;
+            for (; i < enums.size(); ++i) {
+                enums[i].next_geq(candidate);
+                if (enums[i].docid() != candidate) {
+                    break;
+                }
+            }
+
+            if (i == enums.size()) {
+                results += 1;
+                f(candidate);
+            } else if (enums[i].docid() >= end) {
+                break;
+            }
+        }
+
+        return results;
+    }
+
+    // Same as leapfrog_intersect(), but only the shortest list proposes
+    // candidates, one after the other, and the others are only probed with
+    // next_geq(): when they are much longer, the docid they mismatch with
+    // is almost always before the next candidate anyway, so moving the
+    // shortest list with next() saves a search in its block while the
+    // probes decode only the blocks that may contain a candidate.
+    //
+    // Since these blocks are far apart, they are likely cache misses when
+    // the index is cold: with a non-zero DS2I_PREFETCH_DISTANCE, a copy of
+    // the shortest list runs that many candidates ahead and prefetches
+    // them, so that the misses overlap with the decoding of the blocks
+    // already loaded.
+    template <typename Enum, typename Function>
+    uint64_t skewed_intersect(std::vector<Enum>& enums, uint64_t end,
+                              Function&& f)
+    {
+        uint64_t distance = configuration::get().prefetch_distance;
+        if (distance) {
+            Enum ahead = enums[0];
+            return skewed_intersect(enums, end, f, &ahead, distance);
+        }
+        return skewed_intersect(enums, end, f, (Enum*)nullptr, 0);
+    }
+
+    // Picks the intersection algorithm from the ratio between the lengths
+    // of the two shortest lists.
+    template <typename Enum, typename Function>
+    uint64_t intersect(std::vector<Enum>& enums, uint64_t end, Function&& f)
+    {
+        if (enums.size() > 1 and
+            enums[1].size() / skewed_intersection_ratio >= enums[0].size()) {
+            return skewed_intersect(enums, end, f);
+        }
+        return leapfrog_intersect(enums, end, f);
+    }
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "work_stealing_pool.hpp"
+
+namespace ds2i {
+
+    // Runs the prepare() step of the jobs on a work_stealing_pool, in any
+    // order, and their commit() step on the thread that adds them, in the
+    // order they were added. The jobs prepared but not committed yet are
+    // kept in a reorder buffer, so a job that takes long to prepare delays
+    // the commits of the following ones but not their preparation, as long
+    // as their total expected work stays within max_pending_work.
+    class ordered_job_queue {
+    public:
+        class job {
+        public:
+            virtual ~job() {}
+            virtual void prepare() = 0;
+            virtual void commit() = 0;
+        };
+
+        typedef std::shared_ptr<job> job_ptr_type;
+
+        static const uint64_t default_max_pending_work = uint64_t(1) << 28;
+
+        ordered_job_queue(double max_pending_work = default_max_pending_work)
+            : m_max_pending_work(max_pending_work)
+            , m_pending_work(0)
+        {}
+
+        ~ordered_job_queue()
+        {
+            // the jobs still in the pool refer to the buffer
+            for (auto const& s: m_buffer) {
+                wait(*s);
+            }
+        }
+
+        ordered_job_queue(ordered_job_queue const&) = delete;
+        ordered_job_queue& operator=(ordered_job_queue const&) = delete;
+
+        void add_job(job_ptr_type j, double expected_work)
+        {
+            if (!m_pool.num_threads()) { // all in main thread
+                j->prepare();
+                j->commit();
+                return;
+            }
+
+            while (!m_buffer.empty() and
+                   m_pending_work + expected_work > m_max_pending_work) {
+                commit_first();
+            }
+
+            m_buffer.emplace_back(new slot(std::move(j), expected_work));
+            m_pending_work += expected_work;
+            slot* s = m_buffer.back().get();
+            m_pool.submit([this, s]() {
+                try {
+                    s->job->prepare();
+                } catch (...) {
+                    s->error = std::current_exception();
+                }
+                // notified under the lock, since the queue may be
+                // destroyed as soon as it is released
+                std::lock_guard<std::mutex> lock(m_mutex);
+                s->ready = true;
+                m_ready.notify_all();
+            });
+
+            while (!m_buffer.empty() and ready(*m_buffer.front())) {
+                commit_first();
+            }
+        }
+
+        void complete()
+        {
+            while (!m_buffer.empty()) {
+                commit_first();
+            }
+        }
+
+    private:
+        struct slot {
+            slot(job_ptr_type job, double work)
+                : job(std::move(job))
+                , work(work)
+                , ready(false)
+            {}
+
+            job_ptr_type job;
+            double work;
+            bool ready;
+            std::exception_ptr error;
+        };
+
+        bool ready(slot const& s)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return s.ready;
+        }
+
+        void wait(slot const& s)
+        {
+            // help preparing the jobs rather than sleeping while there are
+            // some left
+            while (!ready(s) and m_pool.run_pending_task());
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [&s]() { return s.ready; });
+        }
+
+        // waits for the preparation of the first job in the buffer and
+        // commits it, or rethrows the exception it threw
+        void commit_first()
+        {
+            std::unique_ptr<slot> s = std::move(m_buffer.front());
+            m_buffer.pop_front();
+            wait(*s);
+            m_pending_work -= s->work;
+            if (s->error) {
+                std::rethrow_exception(s->error);
+            }
+            s->job->commit();
+        }
+
+        double m_max_pending_work;
+        double m_pending_work;
+        std::deque<std::unique_ptr<slot>> m_buffer;
+        std::mutex m_mutex;
+        std::condition_variable m_ready;
+        work_stealing_pool m_pool;
+    };
+
+}
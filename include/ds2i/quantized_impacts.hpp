@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "binary_freq_collection.hpp"
+#include "bm25.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Scorer of the indexes whose "frequencies" are quantized impacts: the
+    // score of a document is the sum of its impacts (each multiplied by the
+    // frequency of the term in the query), so it is an integer, exact in a
+    // float up to 2^24, and does not depend on the document length.
+    struct quantized_impact {
+        static const uint64_t wand_data_tag = 2;
+
+        static float doc_term_weight(uint64_t impact, float /* norm_len */)
+        {
+            return float(impact);
+        }
+
+        static float query_term_weight(uint64_t freq, uint64_t /* df */,
+                                       uint64_t /* num_docs */)
+        {
+            return float(freq);
+        }
+    };
+
+    // Maps the Scorer weight of each posting of a collection, i.e. its
+    // document weight times the query weight of its term for a query
+    // frequency of 1, to 1 + floor(weight / max_weight * (levels - 1)),
+    // so that the impacts can be stored in place of the frequencies.
+    template <typename Scorer = bm25>
+    class impact_quantizer {
+    public:
+        static const uint32_t levels = 255;  // 8-bit impacts
+
+        template <typename LengthsIterator>
+        impact_quantizer(LengthsIterator len_it,
+                         binary_freq_collection const& coll)
+            : m_num_docs(coll.num_docs())
+            , m_norm_lens(m_num_docs)
+        {
+            double lens_sum = 0;
+            for (size_t i = 0; i < m_num_docs; ++i) {
+                float len = *len_it++;
+                m_norm_lens[i] = len;
+                lens_sum += len;
+            }
+            float avg_len = float(lens_sum / double(m_num_docs));
+            for (auto& len : m_norm_lens) {
+                len /= avg_len;
+            }
+
+            m_max_weight = 0;
+            for (auto const& seq: coll) {
+                float q_weight = Scorer::query_term_weight(1, seq.docs.size(),
+                                                           m_num_docs);
+                for (size_t i = 0; i < seq.docs.size(); ++i) {
+                    m_max_weight = std::max(m_max_weight,
+                                            weight(q_weight,
+                                                   *(seq.docs.begin() + i),
+                                                   *(seq.freqs.begin() + i)));
+                }
+            }
+        }
+
+        // writes to [impacts] the impacts of the postings of [seq]
+        void quantize(binary_freq_collection::sequence const& seq,
+                      std::vector<uint32_t>& impacts) const
+        {
+            float q_weight = Scorer::query_term_weight(1, seq.docs.size(),
+                                                       m_num_docs);
+            impacts.resize(seq.docs.size());
+            for (size_t i = 0; i < seq.docs.size(); ++i) {
+                float w = weight(q_weight, *(seq.docs.begin() + i),
+                                 *(seq.freqs.begin() + i));
+                impacts[i] = std::min<uint32_t>(
+                    levels, 1 + uint32_t(w / m_max_weight * (levels - 1)));
+            }
+        }
+
+        // Scorer weight represented by an impact of 1
+        float unit() const
+        {
+            return m_max_weight / (levels - 1);
+        }
+
+    private:
+        float weight(float q_weight, uint64_t docid, uint64_t freq) const
+        {
+            return q_weight * Scorer::doc_term_weight(freq, m_norm_lens[docid]);
+        }
+
+        uint64_t m_num_docs;
+        std::vector<float> m_norm_lens;
+        float m_max_weight;
+    };
+
+}
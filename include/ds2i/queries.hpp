@@ -2,10 +2,16 @@
 
 #include <iostream>
 #include <sstream>
+#include <limits>
+#include <numeric>
 
 #include "index_types.hpp"
 #include "wand_data.hpp"
+#include "intersection.hpp"
+#include "quantized_impacts.hpp"
 #include "util.hpp"
+#include "search_utils.hpp"
+#include "work_stealing_pool.hpp"
 
 namespace ds2i {
 
@@ -37,6 +43,15 @@ struct and_query {
     uint64_t operator()(Index const& index, term_id_vec terms) const {
         if (terms.empty())
             return 0;
+
+        auto enums = sorted_enums(index, terms);
+        return intersect(enums, 0, index.num_docs());
+    }
+
+    // enumerators of the distinct terms, by increasing frequency
+    template <typename Index>
+    static std::vector<typename Index::document_enumerator> sorted_enums(
+        Index const& index, term_id_vec terms) {
         remove_duplicate_terms(terms);
 
         typedef typename Index::document_enumerator enum_type;
@@ -47,39 +62,30 @@ struct and_query {
             enums.push_back(index[term]);
         }
 
-        // sort by increasing frequency
         std::sort(enums.begin(), enums.end(),
                   [](enum_type const& lhs, enum_type const& rhs) {
                       return lhs.size() < rhs.size();
                   });
+        return enums;
+    }
 
-        uint64_t results = 0;
-        uint64_t candidate = enums[0].docid();
-        size_t i = 1;
-        while (candidate < index.num_docs()) {
-            for (; i < enums.size(); ++i) {
-                enums[i].next_geq(candidate);
-                if (enums[i].docid() != candidate) {
-                    candidate = enums[i].docid();
-                    i = 0;
-                    break;
-                }
-            }
+    // Counts the documents of [begin, end) in all the lists; the
+    // enumerators must be sorted by increasing frequency and not be past
+    // begin.
+    template <typename Enum>
+    static uint64_t intersect(std::vector<Enum>& enums, uint64_t begin,
+                              uint64_t end) {
+        if (begin) {
+            enums[0].next_geq(begin);
+        }
 
-            if (i == enums.size()) {
-                results += 1;
-                if (with_freqs) {
-                    for (i = 0; i < enums.size(); ++i) {
-                        do_not_optimize_away(enums[i].freq());
-                    }
+        return ds2i::intersect(enums, end, [&](uint64_t /* docid */) {
+            if (with_freqs) {
+                for (auto& e : enums) {
+                    do_not_optimize_away(e.freq());
                 }
-                enums[0].next();
-                candidate = enums[0].docid();
-                i = 1;
             }
-        }
-
-        return results;
+        });
     }
 };
 
@@ -147,48 +153,108 @@ term_freq_vec query_freqs(term_id_vec terms) {
     return query_term_freqs;
 }
 
+// Length of a document, normalized by the average, as used by Scorer; the
+// quantized impacts do not depend on it, so it is not looked up for them.
+template <typename Scorer>
+float doc_norm_len(wand_data<Scorer> const& wdata, uint64_t docid) {
+    return wdata.norm_len(docid);
+}
+
+template <>
+inline float doc_norm_len(wand_data<quantized_impact> const&, uint64_t) {
+    return 0;
+}
+
+// The k highest-scoring (score, docid) pairs seen so far, in a min-heap
+// of fixed capacity. The score a candidate must beat, the lowest in the
+// heap once it is full, is cached in threshold(), so operators can reject
+// candidates whose (partial or bounded) score does not exceed it without
+// touching the heap.
 struct topk_queue {
-    topk_queue(uint64_t k) : m_k(k) {}
+    typedef std::pair<float, uint64_t> entry_type;
+
+    topk_queue(uint64_t k) : m_k(k) {
+        m_q.reserve(k);
+        clear();
+    }
 
-    bool insert(float score) {
+    bool insert(float score, uint64_t docid = 0) {
+        if (DS2I_LIKELY(!would_enter(score))) {
+            return false;
+        }
         if (m_q.size() < m_k) {
-            m_q.push_back(score);
-            std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
-            return true;
-        } else {
-            if (score > m_q.front()) {
-                std::pop_heap(m_q.begin(), m_q.end(), std::greater<float>());
-                m_q.back() = score;
-                std::push_heap(m_q.begin(), m_q.end(), std::greater<float>());
-                return true;
+            m_q.emplace_back(score, docid);
+            std::push_heap(m_q.begin(), m_q.end(), min_heap_order);
+            if (m_q.size() == m_k) {
+                m_threshold = m_q.front().first;
             }
+        } else {
+            sift_down(entry_type(score, docid));
+            m_threshold = m_q.front().first;
         }
-        return false;
+        return true;
     }
 
     bool would_enter(float score) const {
-        return m_q.size() < m_k || score > m_q.front();
+        return score > m_threshold;
+    }
+
+    float threshold() const {
+        return m_threshold;
     }
 
+    // sorts the results by decreasing score
     void finalize() {
-        std::sort_heap(m_q.begin(), m_q.end(), std::greater<float>());
+        std::sort_heap(m_q.begin(), m_q.end(), min_heap_order);
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<entry_type> const& topk() const {
         return m_q;
     }
 
     void clear() {
         m_q.clear();
+        // nothing enters a queue of capacity 0
+        m_threshold = m_k ? std::numeric_limits<float>::lowest()
+                          : std::numeric_limits<float>::infinity();
     }
 
 private:
+    static bool min_heap_order(entry_type const& lhs, entry_type const& rhs) {
+        return lhs.first > rhs.first;
+    }
+
+    // replaces the root of the full heap with [entry], which does not
+    // belong there, and moves it down to its place
+    void sift_down(entry_type entry) {
+        uint64_t i = 0;
+        uint64_t size = m_q.size();
+        while (true) {
+            uint64_t child = 2 * i + 1;
+            if (child >= size) {
+                break;
+            }
+            if (child + 1 < size and
+                m_q[child + 1].first < m_q[child].first) {
+                ++child;
+            }
+            if (entry.first <= m_q[child].first) {
+                break;
+            }
+            m_q[i] = m_q[child];
+            i = child;
+        }
+        m_q[i] = entry;
+    }
+
     uint64_t m_k;
-    std::vector<float> m_q;
+    float m_threshold;
+    std::vector<entry_type> m_q;
 };
 
+template <typename Scorer = bm25>
 struct wand_query {
-    typedef bm25 scorer_type;
+    typedef Scorer scorer_type;
 
     wand_query(wand_data<scorer_type> const& wdata, uint64_t k)
         : m_wdata(&wdata), m_topk(k) {}
@@ -261,7 +327,7 @@ struct wand_query {
             uint64_t pivot_id = ordered_enums[pivot]->docs_enum.docid();
             if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
                 float score = 0;
-                float norm_len = m_wdata->norm_len(pivot_id);
+                float norm_len = doc_norm_len(*m_wdata, pivot_id);
                 for (scored_enum* en : ordered_enums) {
                     if (en->docs_enum.docid() != pivot_id) {
                         break;
@@ -271,7 +337,7 @@ struct wand_query {
                     en->docs_enum.next();
                 }
 
-                m_topk.insert(score);
+                m_topk.insert(score, pivot_id);
                 // resort by docid
                 sort_enums();
             } else {
@@ -297,7 +363,7 @@ struct wand_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -364,7 +430,7 @@ struct ranked_and_query {
                                  enums[i].docs_enum.freq(), norm_len);
                 }
 
-                m_topk.insert(score);
+                m_topk.insert(score, candidate);
                 enums[0].docs_enum.next();
                 candidate = enums[0].docs_enum.docid();
                 i = 1;
@@ -375,7 +441,7 @@ struct ranked_and_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -384,8 +450,16 @@ private:
     topk_queue m_topk;
 };
 
+template <typename Scorer = bm25>
 struct ranked_or_query {
-    typedef bm25 scorer_type;
+    typedef Scorer scorer_type;
+
+    template <typename Enum>
+    struct scored_enum {
+        Enum docs_enum;
+        float q_weight;
+        float max_weight;
+    };
 
     ranked_or_query(wand_data<scorer_type> const& wdata, uint64_t k)
         : m_wdata(&wdata), m_topk(k) {}
@@ -396,6 +470,281 @@ struct ranked_or_query {
         if (terms.empty())
             return 0;
 
+        auto enums = scored_enums(index, terms);
+        evaluate(enums, 0, index.num_docs(), m_topk);
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    template <typename Index>
+    std::vector<scored_enum<typename Index::document_enumerator>> scored_enums(
+        Index const& index, term_id_vec const& terms) const {
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        std::vector<scored_enum<typename Index::document_enumerator>> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto q_weight = scorer_type::query_term_weight(
+                term.second, list.size(), num_docs);
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back({std::move(list), q_weight, max_weight});
+        }
+
+        return enums;
+    }
+
+    // Scores the documents in [begin, end) into [topk]; the enumerators must
+    // not be past begin.
+    template <typename Enum>
+    void evaluate(std::vector<scored_enum<Enum>>& enums, uint64_t begin,
+                  uint64_t end, topk_queue& topk) const {
+        uint64_t cur_doc = end;
+        for (auto& en : enums) {
+            if (begin) {
+                en.docs_enum.next_geq(begin);
+            }
+            cur_doc = std::min(cur_doc, uint64_t(en.docs_enum.docid()));
+        }
+
+        std::vector<scored_enum<Enum>*> matching;
+        matching.reserve(enums.size());
+        while (cur_doc < end) {
+            // the document is scored only if the max scores of its lists
+            // can beat the threshold, saving the length lookup otherwise
+            float upper_bound = 0;
+            uint64_t next_doc = end;
+            matching.clear();
+            for (size_t i = 0; i < enums.size(); ++i) {
+                uint64_t docid = enums[i].docs_enum.docid();
+                if (docid == cur_doc) {
+                    upper_bound += enums[i].max_weight;
+                    matching.push_back(&enums[i]);
+                } else if (docid < next_doc) {
+                    next_doc = docid;
+                }
+            }
+
+            if (topk.would_enter(upper_bound)) {
+                float score = 0;
+                float norm_len = doc_norm_len(*m_wdata, cur_doc);
+                for (auto en : matching) {
+                    score += en->q_weight * scorer_type::doc_term_weight(
+                                                en->docs_enum.freq(), norm_len);
+                }
+                topk.insert(score, cur_doc);
+            }
+
+            for (auto en : matching) {
+                en->docs_enum.next();
+                if (en->docs_enum.docid() < next_doc) {
+                    next_doc = en->docs_enum.docid();
+                }
+            }
+
+            cur_doc = next_doc;
+        }
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+// Buffers the postings of an enumerator one block at a time, through
+// next_block().
+template <typename Enum>
+struct block_cursor {
+    block_cursor(Enum&& e)
+        : docs_enum(std::move(e))
+        , docids(Enum::max_block_size)
+        , freqs(Enum::max_block_size)
+        , pos(0)
+        , size(0) {
+        fill();
+    }
+
+    bool fill() {
+        pos = 0;
+        size = docs_enum.next_block(docids.data(), freqs.data());
+        return size != 0;
+    }
+
+    // docid of the next buffered posting, or [end] if there is none
+    uint64_t docid(uint64_t end) const {
+        return pos != size ? docids[pos] : end;
+    }
+
+    Enum docs_enum;
+    std::vector<uint32_t> docids;
+    std::vector<uint32_t> freqs;
+    uint64_t pos;
+    uint64_t size;
+};
+
+// Processes the union of the lists window by window: the postings of each
+// list falling in a window of window_size docids are taken a block at a
+// time and marked (or scored) in a dense array, instead of merging the
+// lists posting by posting as or_query (and ranked_or_query) does.
+static const uint64_t or_window_size = 4096;
+
+template <bool with_freqs>
+struct block_or_query {
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) const {
+        if (terms.empty())
+            return 0;
+        remove_duplicate_terms(terms);
+
+        typedef block_cursor<typename Index::document_enumerator> cursor_type;
+        std::vector<cursor_type> cursors;
+        cursors.reserve(terms.size());
+        for (auto term : terms) {
+            cursors.emplace_back(index[term]);
+        }
+
+        uint64_t num_docs = index.num_docs();
+        std::vector<uint8_t> hits(or_window_size, 0);
+        uint64_t results = 0;
+        while (true) {
+            uint64_t first = num_docs;
+            for (auto const& c : cursors) {
+                first = std::min(first, c.docid(num_docs));
+            }
+            if (first == num_docs) {
+                break;
+            }
+
+            uint64_t window = first - first % or_window_size;
+            uint64_t end = window + or_window_size;
+            for (auto& c : cursors) {
+                do {
+                    uint64_t last = linear_search_geq(
+                        c.docids.data(), c.pos, c.size, uint32_t(end));
+                    for (uint64_t pos = c.pos; pos != last; ++pos) {
+                        hits[c.docids[pos] - window] = 1;
+                        if (with_freqs) {
+                            do_not_optimize_away(c.freqs[pos]);
+                        }
+                    }
+                    c.pos = last;
+                } while (c.pos == c.size and c.fill());
+            }
+
+            for (auto& hit : hits) {
+                results += hit;
+                hit = 0;
+            }
+        }
+
+        return results;
+    }
+};
+
+struct block_ranked_or_query {
+    typedef bm25 scorer_type;
+
+    block_ranked_or_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata), m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef block_cursor<typename Index::document_enumerator> cursor_type;
+        std::vector<cursor_type> cursors;
+        std::vector<float> q_weights;
+        cursors.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            q_weights.push_back(scorer_type::query_term_weight(
+                term.second, list.size(), num_docs));
+            cursors.emplace_back(std::move(list));
+        }
+
+        // the documents scored in the window are marked in [touched], so
+        // that only those are visited when the window is flushed
+        std::vector<float> scores(or_window_size, 0);
+        std::vector<uint64_t> touched(or_window_size / 64, 0);
+        while (true) {
+            uint64_t first = num_docs;
+            for (auto const& c : cursors) {
+                first = std::min(first, c.docid(num_docs));
+            }
+            if (first == num_docs) {
+                break;
+            }
+
+            uint64_t window = first - first % or_window_size;
+            uint64_t end = window + or_window_size;
+            for (size_t i = 0; i != cursors.size(); ++i) {
+                auto& c = cursors[i];
+                float q_weight = q_weights[i];
+                do {
+                    uint32_t const* docids = c.docids.data();
+                    uint32_t const* freqs = c.freqs.data();
+                    uint64_t last = linear_search_geq(docids, c.pos, c.size,
+                                                      uint32_t(end));
+                    for (uint64_t pos = c.pos; pos != last; ++pos) {
+                        uint32_t docid = docids[pos];
+                        uint32_t offset = docid - window;
+                        scores[offset] +=
+                            q_weight * scorer_type::doc_term_weight(
+                                           freqs[pos], m_wdata->norm_len(docid));
+                        touched[offset / 64] |= uint64_t(1) << (offset % 64);
+                    }
+                    c.pos = last;
+                } while (c.pos == c.size and c.fill());
+            }
+
+            for (uint64_t w = 0; w != touched.size(); ++w) {
+                for (uint64_t bits = touched[w]; bits; bits &= bits - 1) {
+                    uint64_t offset = w * 64 + __builtin_ctzll(bits);
+                    m_topk.insert(scores[offset], window + offset);
+                    scores[offset] = 0;
+                }
+                touched[w] = 0;
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+struct maxscore_query {
+    typedef bm25 scorer_type;
+
+    maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata), m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
         auto query_term_freqs = query_freqs(terms);
 
         uint64_t num_docs = index.num_docs();
@@ -403,6 +752,7 @@ struct ranked_or_query {
         struct scored_enum {
             enum_type docs_enum;
             float q_weight;
+            float max_weight;
         };
 
         std::vector<scored_enum> enums;
@@ -412,9 +762,30 @@ struct ranked_or_query {
             auto list = index[term.first];
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
-            enums.push_back(scored_enum{std::move(list), q_weight});
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back(scored_enum{std::move(list), q_weight, max_weight});
         }
 
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        // sort enumerators by increasing maxscore
+        std::sort(ordered_enums.begin(), ordered_enums.end(),
+                  [](scored_enum* lhs, scored_enum* rhs) {
+                      return lhs->max_weight < rhs->max_weight;
+                  });
+
+        std::vector<float> upper_bounds(ordered_enums.size());
+        upper_bounds[0] = ordered_enums[0]->max_weight;
+        for (size_t i = 1; i < ordered_enums.size(); ++i) {
+            upper_bounds[i] =
+                upper_bounds[i - 1] + ordered_enums[i]->max_weight;
+        }
+
+        uint64_t non_essential_lists = 0;
         uint64_t cur_doc =
             std::min_element(
                 enums.begin(), enums.end(),
@@ -423,23 +794,45 @@ struct ranked_or_query {
                 })
                 ->docs_enum.docid();
 
-        while (cur_doc < index.num_docs()) {
+        while (non_essential_lists < ordered_enums.size() &&
+               cur_doc < index.num_docs()) {
             float score = 0;
             float norm_len = m_wdata->norm_len(cur_doc);
             uint64_t next_doc = index.num_docs();
-            for (size_t i = 0; i < enums.size(); ++i) {
-                if (enums[i].docs_enum.docid() == cur_doc) {
-                    score += enums[i].q_weight *
+            for (size_t i = non_essential_lists; i < ordered_enums.size();
+                 ++i) {
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    score += ordered_enums[i]->q_weight *
                              scorer_type::doc_term_weight(
-                                 enums[i].docs_enum.freq(), norm_len);
-                    enums[i].docs_enum.next();
+                                 ordered_enums[i]->docs_enum.freq(), norm_len);
+                    ordered_enums[i]->docs_enum.next();
+                }
+                if (ordered_enums[i]->docs_enum.docid() < next_doc) {
+                    next_doc = ordered_enums[i]->docs_enum.docid();
+                }
+            }
+
+            // try to complete evaluation with non-essential lists
+            for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
+                if (!m_topk.would_enter(score + upper_bounds[i])) {
+                    break;
+                }
+                ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
+                    score += ordered_enums[i]->q_weight *
+                             scorer_type::doc_term_weight(
+                                 ordered_enums[i]->docs_enum.freq(), norm_len);
                 }
-                if (enums[i].docs_enum.docid() < next_doc) {
-                    next_doc = enums[i].docs_enum.docid();
+            }
+
+            if (m_topk.insert(score, cur_doc)) {
+                // update non-essential lists
+                while (non_essential_lists < ordered_enums.size() &&
+                       !m_topk.would_enter(upper_bounds[non_essential_lists])) {
+                    non_essential_lists += 1;
                 }
             }
 
-            m_topk.insert(score);
             cur_doc = next_doc;
         }
 
@@ -447,7 +840,7 @@ struct ranked_or_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -456,10 +849,14 @@ private:
     topk_queue m_topk;
 };
 
-struct maxscore_query {
+// WAND where the pivot, selected with the list max scores, is checked
+// against the block max scores of the lists up to it: if they cannot
+// make it into the top-k, the lists are moved past the end of the first
+// of those blocks to end.
+struct block_max_wand_query {
     typedef bm25 scorer_type;
 
-    maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+    block_max_wand_query(wand_data<scorer_type> const& wdata, uint64_t k)
         : m_wdata(&wdata), m_topk(k) {}
 
     template <typename Index>
@@ -472,8 +869,10 @@ struct maxscore_query {
 
         uint64_t num_docs = index.num_docs();
         typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::block_enum block_enum_type;
         struct scored_enum {
             enum_type docs_enum;
+            block_enum_type block_enum;
             float q_weight;
             float max_weight;
         };
@@ -486,7 +885,176 @@ struct maxscore_query {
             auto q_weight = scorer_type::query_term_weight(
                 term.second, list.size(), num_docs);
             auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
-            enums.push_back(scored_enum{std::move(list), q_weight, max_weight});
+            enums.push_back(scored_enum{std::move(list),
+                                        m_wdata->get_block_enum(term.first),
+                                        q_weight, max_weight});
+        }
+
+        std::vector<scored_enum*> ordered_enums;
+        ordered_enums.reserve(enums.size());
+        for (auto& en : enums) {
+            ordered_enums.push_back(&en);
+        }
+
+        auto sort_enums = [&]() {
+            // sort enumerators by increasing docid
+            std::sort(ordered_enums.begin(), ordered_enums.end(),
+                      [](scored_enum* lhs, scored_enum* rhs) {
+                          return lhs->docs_enum.docid() <
+                                 rhs->docs_enum.docid();
+                      });
+        };
+
+        // move the list [i] to [docid] and bubble it down
+        auto advance = [&](size_t i, uint64_t docid) {
+            ordered_enums[i]->docs_enum.next_geq(docid);
+            for (++i; i < ordered_enums.size(); ++i) {
+                if (ordered_enums[i]->docs_enum.docid() <
+                    ordered_enums[i - 1]->docs_enum.docid()) {
+                    std::swap(ordered_enums[i], ordered_enums[i - 1]);
+                } else {
+                    break;
+                }
+            }
+        };
+
+        sort_enums();
+        while (true) {
+            // find pivot
+            float upper_bound = 0;
+            size_t pivot;
+            bool found_pivot = false;
+            for (pivot = 0; pivot < ordered_enums.size(); ++pivot) {
+                if (ordered_enums[pivot]->docs_enum.docid() == num_docs) {
+                    break;
+                }
+                upper_bound += ordered_enums[pivot]->max_weight;
+                if (m_topk.would_enter(upper_bound)) {
+                    found_pivot = true;
+                    break;
+                }
+            }
+
+            // no pivot found, we can stop the search
+            if (!found_pivot) {
+                break;
+            }
+
+            // the lists positioned on the pivot contribute to its score too
+            uint64_t pivot_id = ordered_enums[pivot]->docs_enum.docid();
+            while (pivot + 1 < ordered_enums.size() and
+                   ordered_enums[pivot + 1]->docs_enum.docid() == pivot_id) {
+                ++pivot;
+            }
+
+            float block_upper_bound = 0;
+            for (size_t i = 0; i <= pivot; ++i) {
+                auto& block_enum = ordered_enums[i]->block_enum;
+                block_enum.next_geq(pivot_id);
+                block_upper_bound +=
+                    ordered_enums[i]->q_weight * block_enum.score();
+            }
+
+            if (m_topk.would_enter(block_upper_bound)) {
+                if (pivot_id == ordered_enums[0]->docs_enum.docid()) {
+                    float score = 0;
+                    float norm_len = m_wdata->norm_len(pivot_id);
+                    for (scored_enum* en : ordered_enums) {
+                        if (en->docs_enum.docid() != pivot_id) {
+                            break;
+                        }
+                        score +=
+                            en->q_weight *
+                            scorer_type::doc_term_weight(en->docs_enum.freq(),
+                                                         norm_len);
+                        en->docs_enum.next();
+                    }
+
+                    m_topk.insert(score, pivot_id);
+                    // resort by docid
+                    sort_enums();
+                } else {
+                    // no match, move farthest list up to the pivot
+                    uint64_t next_list = pivot;
+                    for (; ordered_enums[next_list]->docs_enum.docid() ==
+                           pivot_id;
+                         --next_list)
+                        ;
+                    advance(next_list, pivot_id);
+                }
+            } else {
+                // no document can make it into the top-k before the end of
+                // the first block, or before the first list after the pivot
+                uint64_t next = num_docs;
+                if (pivot + 1 < ordered_enums.size()) {
+                    next = ordered_enums[pivot + 1]->docs_enum.docid();
+                }
+                size_t next_list = 0;
+                for (size_t i = 0; i <= pivot; ++i) {
+                    next = std::min(next,
+                                    ordered_enums[i]->block_enum.docid() + 1);
+                    if (ordered_enums[i]->max_weight >
+                        ordered_enums[next_list]->max_weight) {
+                        next_list = i;
+                    }
+                }
+                // NOTE: next > pivot_id, as all the blocks end at or after
+                // the pivot
+                advance(next_list, next);
+            }
+        }
+
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    wand_data<scorer_type> const* m_wdata;
+    topk_queue m_topk;
+};
+
+// MaxScore where, while a candidate is completed, each non-essential list
+// is searched only if the max score of its block containing the candidate
+// can still make it into the top-k.
+struct block_max_maxscore_query {
+    typedef bm25 scorer_type;
+
+    block_max_maxscore_query(wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_wdata(&wdata), m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto query_term_freqs = query_freqs(terms);
+
+        uint64_t num_docs = index.num_docs();
+        typedef typename Index::document_enumerator enum_type;
+        typedef typename wand_data<scorer_type>::block_enum block_enum_type;
+        struct scored_enum {
+            enum_type docs_enum;
+            block_enum_type block_enum;
+            float q_weight;
+            float max_weight;
+        };
+
+        std::vector<scored_enum> enums;
+        enums.reserve(query_term_freqs.size());
+
+        for (auto term : query_term_freqs) {
+            auto list = index[term.first];
+            auto q_weight = scorer_type::query_term_weight(
+                term.second, list.size(), num_docs);
+            auto max_weight = q_weight * m_wdata->max_term_weight(term.first);
+            enums.push_back(scored_enum{std::move(list),
+                                        m_wdata->get_block_enum(term.first),
+                                        q_weight, max_weight});
         }
 
         std::vector<scored_enum*> ordered_enums;
@@ -535,12 +1103,27 @@ struct maxscore_query {
                 }
             }
 
-            // try to complete evaluation with non-essential lists
+            // try to complete evaluation with non-essential lists; before
+            // searching a list, its list max score is replaced with the max
+            // score of the block containing the candidate, which is cheaper
+            // to reach than the postings
             for (size_t i = non_essential_lists - 1; i + 1 > 0; --i) {
                 if (!m_topk.would_enter(score + upper_bounds[i])) {
                     break;
                 }
-                ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                auto& block_enum = ordered_enums[i]->block_enum;
+                block_enum.next_geq(cur_doc);
+                float block_upper_bound =
+                    score + ordered_enums[i]->q_weight * block_enum.score();
+                if (i != 0) {
+                    block_upper_bound += upper_bounds[i - 1];
+                }
+                if (!m_topk.would_enter(block_upper_bound)) {
+                    break;
+                }
+                if (ordered_enums[i]->docs_enum.docid() < cur_doc) {
+                    ordered_enums[i]->docs_enum.next_geq(cur_doc);
+                }
                 if (ordered_enums[i]->docs_enum.docid() == cur_doc) {
                     score += ordered_enums[i]->q_weight *
                              scorer_type::doc_term_weight(
@@ -548,7 +1131,7 @@ struct maxscore_query {
                 }
             }
 
-            if (m_topk.insert(score)) {
+            if (m_topk.insert(score, cur_doc)) {
                 // update non-essential lists
                 while (non_essential_lists < ordered_enums.size() &&
                        !m_topk.would_enter(upper_bounds[non_essential_lists])) {
@@ -563,7 +1146,7 @@ struct maxscore_query {
         return m_topk.topk().size();
     }
 
-    std::vector<float> const& topk() const {
+    std::vector<topk_queue::entry_type> const& topk() const {
         return m_topk.topk();
     }
 
@@ -572,4 +1155,109 @@ private:
     topk_queue m_topk;
 };
 
+// Intra-query parallelism: the docid universe is split into ranges, each
+// evaluated by a task of a work_stealing_pool on its own copies of the
+// enumerators, and the partial results are merged.
+
+// a range is not worth a task if the longest list has fewer postings in it
+static const uint64_t min_range_postings = 1 << 16;
+
+// Bounds of at most max_ranges docid ranges, from 0 to num_docs, starting
+// at the first docid of blocks of [longest], so that the postings of the
+// longest list are split evenly and each range starts its decoding at a
+// block boundary.
+template <typename Enum>
+std::vector<uint64_t> docid_ranges(Enum longest, uint64_t num_docs,
+                                   uint64_t max_ranges) {
+    uint64_t size = longest.size();
+    uint64_t ranges =
+        std::max<uint64_t>(1, std::min(max_ranges, size / min_range_postings));
+    std::vector<uint64_t> bounds(1, 0);
+    for (uint64_t r = 1; r < ranges; ++r) {
+        uint64_t pos = r * size / ranges;
+        longest.move(pos - pos % Enum::max_block_size);
+        if (longest.docid() > bounds.back()) {
+            bounds.push_back(longest.docid());
+        }
+    }
+    bounds.push_back(num_docs);
+    return bounds;
+}
+
+template <bool with_freqs>
+struct parallel_and_query {
+    parallel_and_query(work_stealing_pool& pool) : m_pool(&pool) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) const {
+        if (terms.empty())
+            return 0;
+
+        typedef and_query<with_freqs> query_type;
+        auto enums = query_type::sorted_enums(index, terms);
+        auto bounds = docid_ranges(enums.back(), index.num_docs(),
+                                   4 * (m_pool->num_threads() + 1));
+
+        std::vector<uint64_t> results(bounds.size() - 1);
+        m_pool->parallel_for(results.size(), [&](size_t r) {
+            auto range_enums = enums;
+            results[r] =
+                query_type::intersect(range_enums, bounds[r], bounds[r + 1]);
+        });
+        return std::accumulate(results.begin(), results.end(), uint64_t(0));
+    }
+
+private:
+    work_stealing_pool* m_pool;
+};
+
+template <typename Scorer = bm25>
+struct parallel_ranked_or_query {
+    typedef Scorer scorer_type;
+
+    parallel_ranked_or_query(work_stealing_pool& pool,
+                             wand_data<scorer_type> const& wdata, uint64_t k)
+        : m_pool(&pool), m_query(wdata, k), m_k(k), m_topk(k) {}
+
+    template <typename Index>
+    uint64_t operator()(Index const& index, term_id_vec const& terms) {
+        m_topk.clear();
+        if (terms.empty())
+            return 0;
+
+        auto enums = m_query.scored_enums(index, terms);
+        auto longest = std::max_element(
+            enums.begin(), enums.end(), [](auto const& lhs, auto const& rhs) {
+                return lhs.docs_enum.size() < rhs.docs_enum.size();
+            });
+        auto bounds = docid_ranges(longest->docs_enum, index.num_docs(),
+                                   4 * (m_pool->num_threads() + 1));
+
+        std::vector<topk_queue> partial(bounds.size() - 1, topk_queue(m_k));
+        m_pool->parallel_for(partial.size(), [&](size_t r) {
+            auto range_enums = enums;
+            m_query.evaluate(range_enums, bounds[r], bounds[r + 1],
+                             partial[r]);
+        });
+
+        for (auto const& topk : partial) {
+            for (auto const& entry : topk.topk()) {
+                m_topk.insert(entry.first, entry.second);
+            }
+        }
+        m_topk.finalize();
+        return m_topk.topk().size();
+    }
+
+    std::vector<topk_queue::entry_type> const& topk() const {
+        return m_topk.topk();
+    }
+
+private:
+    work_stealing_pool* m_pool;
+    ranked_or_query<scorer_type> m_query;
+    uint64_t m_k;
+    topk_queue m_topk;
+};
+
 }  // namespace ds2i
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace ds2i {
+
+// Writes to out[0, n) the values encoded by the gaps (minus one) in
+// in[0, n), the first one being base + in[0]. [in] and [out] can coincide.
+inline void prefix_sum_gaps(uint32_t const* in, uint32_t* out, uint64_t n,
+                            uint32_t base) {
+    uint64_t i = 0;
+    uint32_t prev = base - 1;
+#if defined(__AVX2__)
+    __m256i ones = _mm256_set1_epi32(1);
+    __m256i last = _mm256_set1_epi32(7);
+    __m256i carry = _mm256_set1_epi32(prev);
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_add_epi32(
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(in + i)),
+            ones);
+        // prefix sums within each 128-bit lane...
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        // ...then the last sum of the low lane is added to the high one
+        __m256i low = _mm256_shuffle_epi32(x, 0xFF);
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(low, low, 0x08));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last);
+    }
+    if (i) {
+        prev = out[i - 1];
+    }
+#elif defined(__SSE4_1__)
+    __m128i ones = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(prev);
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_add_epi32(
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i)), ones);
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    if (i) {
+        prev = out[i - 1];
+    }
+#endif
+    for (; i != n; ++i) {
+        prev += in[i] + 1;
+        out[i] = prev;
+    }
+}
+
+// Position of the first value >= x in the sorted range a[begin, end), or
+// end if there is none. The range is scanned comparing several values at
+// once, so it should be used when the position is expected to be close.
+inline uint64_t linear_search_geq(uint32_t const* a, uint64_t begin,
+                                  uint64_t end, uint32_t x) {
+    uint64_t i = begin;
+#if defined(__AVX2__)
+    __m256i xs = _mm256_set1_epi32(x);
+    for (; i + 8 <= end; i += 8) {
+        __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+        // unsigned v >= x
+        __m256i geq = _mm256_cmpeq_epi32(_mm256_max_epu32(v, xs), v);
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(geq));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE4_1__)
+    __m128i xs = _mm_set1_epi32(x);
+    for (; i + 4 <= end; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i));
+        __m128i geq = _mm_cmpeq_epi32(_mm_max_epu32(v, xs), v);
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(geq));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i != end and a[i] < x; ++i)
+        ;
+    return i;
+}
+
+// Same as linear_search_geq, but, past the first linear_window values,
+// gallops ahead and then binary searches, so that long skips cost a
+// logarithmic number of probes.
+inline uint64_t search_geq(uint32_t const* a, uint64_t begin, uint64_t end,
+                           uint32_t x) {
+    static const uint64_t linear_window = 16;
+    if (end - begin <= linear_window or a[begin + linear_window - 1] >= x) {
+        return linear_search_geq(a, begin,
+                                 std::min(end, begin + linear_window), x);
+    }
+
+    // a[lo] < x and, if hi != end, a[hi] >= x
+    uint64_t lo = begin + linear_window - 1;
+    uint64_t step = linear_window;
+    uint64_t hi = lo + step;
+    while (hi < end and a[hi] < x) {
+        lo = hi;
+        step *= 2;
+        hi = lo + step;
+    }
+    hi = std::min(hi, end);
+    while (hi - lo > linear_window) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < x) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return linear_search_geq(a, lo + 1, hi, x);
+}
+
+// Absolute docids of a decoded block of gaps, used by the enumerators to
+// search within the block. They are computed with a single prefix sum the
+// first time a seek needs them and then reused until the next block is
+// decoded; since enumerators only move forward, the sum starts from the
+// current position.
+struct block_docids {
+    block_docids(uint64_t capacity) : m_docids(capacity), m_valid(false) {}
+
+    void invalidate() {
+        m_valid = false;
+    }
+
+    // [gaps] holds the gaps (minus one) of a block of [size] docids, whose
+    // one at position [pos] is [docid]; the returned docids are valid from
+    // the position of the first call after invalidate()
+    uint32_t const* get(uint32_t const* gaps, uint32_t pos, uint32_t size,
+                        uint32_t docid) {
+        if (!m_valid) {
+            m_docids[pos] = docid;
+            prefix_sum_gaps(gaps + pos + 1, m_docids.data() + pos + 1,
+                            size - pos - 1, docid + 1);
+            m_valid = true;
+        }
+        return m_docids.data();
+    }
+
+private:
+    std::vector<uint32_t> m_docids;
+    bool m_valid;
+};
+
+}  // namespace ds2i
@@ -4,7 +4,7 @@
 #include "compact_elias_fano.hpp"
 #include "integer_codes.hpp"
 #include "global_parameters.hpp"
-#include "semiasync_queue.hpp"
+#include "ordered_job_queue.hpp"
 
 namespace ds2i {
 
@@ -19,8 +19,7 @@ namespace ds2i {
         class builder {
         public:
             builder(global_parameters const& params)
-                : m_queue(1 << 24)
-                , m_params(params)
+                : m_params(params)
                 , m_sequences(params)
             {}
 
@@ -45,7 +44,7 @@ namespace ds2i {
         private:
 
             template <typename Iterator>
-            struct sequence_adder : semiasync_queue::job {
+            struct sequence_adder : ordered_job_queue::job {
                 sequence_adder(builder& b,
                                Iterator begin,
                                uint64_t last_element,
@@ -80,7 +79,7 @@ namespace ds2i {
                 succinct::bit_vector_builder bits;
             };
 
-            semiasync_queue m_queue;
+            ordered_job_queue m_queue;
             global_parameters m_params;
             bitvector_collection::builder m_sequences;
         };
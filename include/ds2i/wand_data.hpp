@@ -1,22 +1,33 @@
 #pragma once
 
+#include <stdexcept>
+
 #include <succinct/mappable_vector.hpp>
 
 #include "binary_freq_collection.hpp"
 #include "bm25.hpp"
 #include "util.hpp"
+#include "search_utils.hpp"
 
 namespace ds2i {
 
     template <typename Scorer = bm25>
     class wand_data {
     public:
+        // number of postings covered by each block max score; it is a
+        // divisor of the block sizes of the block and DINT indexes, so that
+        // the score blocks never straddle the index blocks
+        static const uint64_t default_block_size = 128;
+
         wand_data()
+            : m_scorer(Scorer::wand_data_tag)
         {}
 
         template <typename LengthsIterator>
         wand_data(LengthsIterator len_it, uint64_t num_docs,
-                  binary_freq_collection const& coll)
+                  binary_freq_collection const& coll,
+                  uint64_t block_size = default_block_size)
+            : m_scorer(Scorer::wand_data_tag)
         {
             std::vector<float> norm_lens(num_docs);
             double lens_sum = 0;
@@ -31,17 +42,29 @@ namespace ds2i {
                 norm_lens[i] /= avg_len;
             }
 
-            logger() << "Storing max weight for each list...";
+            logger() << "Storing max weight for each list and block of "
+                     << block_size << " postings...";
             std::vector<float> max_term_weight;
+            std::vector<uint64_t> block_endpoints(1, 0);
+            std::vector<uint32_t> block_docids;
+            std::vector<float> block_max_weights;
             for (auto const& seq: coll) {
                 float max_score = 0;
+                float block_max_score = 0;
                 for (size_t i = 0; i < seq.docs.size(); ++i) {
                     uint64_t docid = *(seq.docs.begin() + i);
                     uint64_t freq = *(seq.freqs.begin() + i);
                     float score = Scorer::doc_term_weight(freq, norm_lens[docid]);
                     max_score = std::max(max_score, score);
+                    block_max_score = std::max(block_max_score, score);
+                    if ((i + 1) % block_size == 0 or i + 1 == seq.docs.size()) {
+                        block_docids.push_back(docid);
+                        block_max_weights.push_back(block_max_score);
+                        block_max_score = 0;
+                    }
                 }
                 max_term_weight.push_back(max_score);
+                block_endpoints.push_back(block_docids.size());
                 if ((max_term_weight.size() % 1000000) == 0) {
                     logger() << max_term_weight.size() << " list processed";
                 }
@@ -50,8 +73,54 @@ namespace ds2i {
 
             m_norm_lens.steal(norm_lens);
             m_max_term_weight.steal(max_term_weight);
+            m_block_endpoints.steal(block_endpoints);
+            m_block_docids.steal(block_docids);
+            m_block_max_weights.steal(block_max_weights);
         }
 
+        // Shallow enumerator over the block max scores of a list: moving it
+        // only touches the block boundaries, not the postings.
+        class block_enum {
+        public:
+            block_enum(uint32_t const* docids, float const* max_weights,
+                       uint64_t size, uint64_t universe)
+                : m_docids(docids)
+                , m_max_weights(max_weights)
+                , m_size(size)
+                , m_universe(universe)
+                , m_pos(0)
+            {}
+
+            // moves to the first block whose last docid is >= lower
+            void next_geq(uint64_t lower)
+            {
+                if (m_pos != m_size and m_docids[m_pos] < lower) {
+                    m_pos = search_geq(m_docids, m_pos, m_size,
+                                       uint32_t(lower));
+                }
+            }
+
+            // last docid of the current block, or the universe past the end
+            uint64_t docid() const
+            {
+                return DS2I_LIKELY(m_pos != m_size) ? m_docids[m_pos]
+                                                    : m_universe;
+            }
+
+            // max weight of the documents in the current block
+            float score() const
+            {
+                return DS2I_LIKELY(m_pos != m_size) ? m_max_weights[m_pos] : 0;
+            }
+
+        private:
+            uint32_t const* m_docids;
+            float const* m_max_weights;
+            uint64_t m_size;
+            uint64_t m_universe;
+            uint64_t m_pos;
+        };
+
         float norm_len(uint64_t doc_id) const
         {
             return m_norm_lens[doc_id];
@@ -62,24 +131,53 @@ namespace ds2i {
             return m_max_term_weight[term_id];
         }
 
+        block_enum get_block_enum(uint64_t term_id) const
+        {
+            uint64_t begin = m_block_endpoints[term_id];
+            uint64_t end = m_block_endpoints[term_id + 1];
+            return block_enum(m_block_docids.data() + begin,
+                              m_block_max_weights.data() + begin,
+                              end - begin, m_norm_lens.size());
+        }
+
         void swap(wand_data& other)
         {
+            std::swap(m_scorer, other.m_scorer);
             m_norm_lens.swap(other.m_norm_lens);
             m_max_term_weight.swap(other.m_max_term_weight);
+            m_block_endpoints.swap(other.m_block_endpoints);
+            m_block_docids.swap(other.m_block_docids);
+            m_block_max_weights.swap(other.m_block_max_weights);
         }
 
+        // Mapping data built for another scorer throws: its weights would
+        // give wrong upper bounds, and wrong results, without any error.
         template <typename Visitor>
         void map(Visitor& visit)
         {
+            visit(m_scorer, "m_scorer");
+            // NOTE: checked before the rest is visited, since the layout of
+            // other files is unknown
+            if (m_scorer != Scorer::wand_data_tag) {
+                throw std::runtime_error(
+                    "The wand data was built for another scorer");
+            }
             visit
                 (m_norm_lens, "m_norm_lens")
                 (m_max_term_weight, "m_max_term_weight")
+                (m_block_endpoints, "m_block_endpoints")
+                (m_block_docids, "m_block_docids")
+                (m_block_max_weights, "m_block_max_weights")
                 ;
         }
 
     private:
+        uint64_t m_scorer;
         succinct::mapper::mappable_vector<float> m_norm_lens;
         succinct::mapper::mappable_vector<float> m_max_term_weight;
+        succinct::mapper::mappable_vector<uint64_t> m_block_endpoints;
+        succinct::mapper::mappable_vector<uint32_t> m_block_docids;
+        succinct::mapper::mappable_vector<float> m_block_max_weights;
     };
 
 }
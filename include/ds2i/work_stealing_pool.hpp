@@ -0,0 +1,195 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+
+#include "configuration.hpp"
+#include "util.hpp"
+
+namespace ds2i {
+
+    // Pool of worker threads, each with its own deque of tasks: a worker
+    // runs the tasks of its deque in the order they were queued and, when
+    // it is empty, steals the oldest ones of the others. The thread calling
+    // parallel_for() runs the tasks of its group too, so a pool of n
+    // workers evaluates a group on n + 1 threads.
+    class work_stealing_pool {
+    public:
+        typedef std::function<void()> task_type;
+
+        work_stealing_pool(size_t num_threads =
+                               configuration::get().worker_threads)
+            : m_queues(num_threads)
+            , m_pending(0)
+            , m_next_queue(0)
+            , m_stop(false)
+        {
+            for (size_t i = 0; i < num_threads; ++i) {
+                m_queues[i].reset(new task_queue());
+            }
+            for (size_t i = 0; i < num_threads; ++i) {
+                m_workers.emplace_back([this, i]() { work(i); });
+            }
+        }
+
+        ~work_stealing_pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_stop = true;
+            }
+            m_wake_up.notify_all();
+            for (auto& t: m_workers) {
+                t.join();
+            }
+        }
+
+        work_stealing_pool(work_stealing_pool const&) = delete;
+        work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+        size_t num_threads() const
+        {
+            return m_workers.size();
+        }
+
+        // Runs f(0), ..., f(n - 1) on the pool and returns when all of them
+        // have completed; the first exception thrown by a task, if any, is
+        // rethrown here.
+        template <typename Function>
+        void parallel_for(size_t n, Function const& f)
+        {
+            if (m_workers.empty() or n == 1) {
+                for (size_t i = 0; i < n; ++i) {
+                    f(i);
+                }
+                return;
+            }
+
+            std::atomic<size_t> remaining(n);
+            std::exception_ptr error;
+            std::mutex error_mutex;
+            for (size_t i = 0; i < n; ++i) {
+                submit([&, i]() {
+                    try {
+                        f(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                    }
+                    remaining -= 1;
+                });
+            }
+
+            // help until the whole group is done; the tasks run here may
+            // belong to other groups as well
+            while (remaining) {
+                if (!run_pending_task()) {
+                    std::this_thread::yield();
+                }
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Queues [task] to be run by a worker; the pool must have at least
+        // one, and tasks must not throw.
+        void submit(task_type task)
+        {
+            assert(!m_workers.empty());
+            size_t i = m_next_queue++ % m_queues.size();
+            {
+                // counted before it can be taken, so that m_pending never
+                // goes below the number of queued tasks
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_pending += 1;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_queues[i]->mutex);
+                m_queues[i]->tasks.push_back(std::move(task));
+            }
+            m_wake_up.notify_one();
+        }
+
+        // Runs one of the queued tasks, if any, on the calling thread
+        bool run_pending_task()
+        {
+            task_type task;
+            if (m_queues.empty() or
+                !steal(m_next_queue % m_queues.size(), task)) {
+                return false;
+            }
+            task();
+            return true;
+        }
+
+    private:
+        struct task_queue {
+            std::mutex mutex;
+            std::deque<task_type> tasks;
+        };
+
+        bool pop(size_t i, task_type& task)
+        {
+            std::lock_guard<std::mutex> lock(m_queues[i]->mutex);
+            if (m_queues[i]->tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_queues[i]->tasks.front());
+            m_queues[i]->tasks.pop_front();
+            m_pending -= 1;
+            return true;
+        }
+
+        // takes the oldest task of any queue, starting from the i-th
+        bool steal(size_t i, task_type& task)
+        {
+            for (size_t k = 0; k < m_queues.size(); ++k) {
+                auto& q = *m_queues[(i + k) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                if (!q.tasks.empty()) {
+                    task = std::move(q.tasks.front());
+                    q.tasks.pop_front();
+                    m_pending -= 1;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void work(size_t i)
+        {
+            task_type task;
+            while (true) {
+                if (pop(i, task) or steal(i + 1, task)) {
+                    task();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                m_wake_up.wait(lock, [this]() { return m_stop or m_pending; });
+                if (m_stop and !m_pending) {
+                    return;
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<task_queue>> m_queues;
+        std::vector<std::thread> m_workers;
+        std::atomic<size_t> m_pending;
+        std::atomic<size_t> m_next_queue;
+        bool m_stop;
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_wake_up;
+    };
+
+}
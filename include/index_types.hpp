@@ -52,11 +52,16 @@ typedef block_freq_index<streamvbyte_block> block_streamvbyte_index;
 
 // collector type
 using adjusted_collector_type = adjusted<constants::max_entry_size>;
+using approximate_collector_type = approximate<constants::max_entry_size>;
 
 // statistic types
 using adjusted_block_stats_type = block_statistics<adjusted_collector_type>;
 using adjusted_block_multi_stats_type =
     block_multi_statistics<adjusted_collector_type>;
+using approximate_block_stats_type =
+    block_statistics<approximate_collector_type>;
+using approximate_block_multi_stats_type =
+    block_multi_statistics<approximate_collector_type>;
 
 // dictionary_builders
 using single_rectangular_builder =
@@ -71,6 +76,14 @@ using multi_packed_builder =
     decreasing_static_frequencies<multi_dictionary_packed_type,
                                   adjusted_block_multi_stats_type>;
 
+using single_packed_approx_builder =
+    decreasing_static_frequencies<single_dictionary_packed_type,
+                                  approximate_block_stats_type>;
+
+using multi_packed_approx_builder =
+    decreasing_static_frequencies<multi_dictionary_packed_type,
+                                  approximate_block_multi_stats_type>;
+
 // DINT configurations (all use optimal block parsing)
 using single_rect_dint_index =
     dict_freq_index<single_rectangular_builder, opt_dint_single_dict_block>;
@@ -78,13 +91,22 @@ using single_packed_dint_index =
     dict_freq_index<single_packed_builder, opt_dint_single_dict_block>;
 using multi_packed_dint_index =
     dict_freq_index<multi_packed_builder, opt_dint_multi_dict_block>;
+using single_packed_dint_exc_index =
+    dict_freq_index<single_packed_builder,
+                    opt_dint_single_dict_exceptions_block>;
+using single_packed_approx_dint_index =
+    dict_freq_index<single_packed_approx_builder, opt_dint_single_dict_block>;
+using multi_packed_approx_dint_index =
+    dict_freq_index<multi_packed_approx_builder, opt_dint_multi_dict_block>;
 }  // namespace ds2i
 
 #define DS2I_INDEX_TYPES                                                       \
     (ef)(single)(uniform)(opt)(block_optpfor)(block_varintg8iu)(               \
         block_interpolative)(block_qmx)(block_mixed)(block_u32)(block_vbyte)(  \
         block_simple16)(block_varintgb)(block_maskedvbyte)(block_streamvbyte)( \
-        single_rect_dint)(single_packed_dint)(multi_packed_dint)
+        single_rect_dint)(single_packed_dint)(multi_packed_dint)(              \
+        single_packed_dint_exc)(single_packed_approx_dint)(                    \
+        multi_packed_approx_dint)
 #define DS2I_BLOCK_INDEX_TYPES                                                \
     (block_optpfor)(block_varintg8iu)(block_interpolative)(block_qmx)(        \
         block_mixed)(block_u32)(block_vbyte)(block_simple16)(block_varintgb)( \
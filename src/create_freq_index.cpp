@@ -55,7 +55,7 @@ template <typename CollectionType>
 void create_collection(std::string input_basename,
                        global_parameters const& params,
                        const char* output_filename, bool check,
-                       std::string const& seq_type) {
+                       bool on_disk, std::string const& seq_type) {
     binary_freq_collection input(input_basename.c_str());
     size_t num_docs = input.num_docs();
     double tick = get_time_usecs();
@@ -63,6 +63,11 @@ void create_collection(std::string input_basename,
 
     typename CollectionType::builder builder(num_docs, params);
     build_model<CollectionType>(input_basename, builder);
+    if (on_disk) {
+        std::string lists_filename = std::string(output_filename) + ".lists";
+        logger() << "Writing the lists to " << lists_filename << std::endl;
+        builder.spill_lists_to(lists_filename);
+    }
 
     logger() << "Processing " << input.num_docs() << " documents..."
              << std::endl;
@@ -114,7 +119,7 @@ int main(int argc, const char** argv) {
     if (argc < mandatory) {
         std::cerr << "Usage: " << argv[0] << ":\n"
                   << "\t<index_type> <collection_basename> [<output_filename>] "
-                     "[--check]"
+                     "[--check] [--on-disk]"
                   << std::endl;
         return 1;
     }
@@ -127,20 +132,28 @@ int main(int argc, const char** argv) {
     }
 
     bool check = false;
-    if (argc > mandatory + 1 and
-        std::string(argv[mandatory + 1]) == "--check") {
-        check = true;
+    bool on_disk = false;
+    for (int i = mandatory + 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--check") {
+            check = true;
+        } else if (arg == "--on-disk") {
+            on_disk = true;
+        } else {
+            logger() << "ERROR: Unknown argument " << arg << std::endl;
+            return 1;
+        }
     }
 
     ds2i::global_parameters params;
     params.log_partition_size = configuration::get().log_partition_size;
 
     if (false) {
-#define LOOP_BODY(R, DATA, T)                                      \
-    }                                                              \
-    else if (type == BOOST_PP_STRINGIZE(T)) {                      \
-        create_collection<BOOST_PP_CAT(T, _index)>(                \
-            input_basename, params, output_filename, check, type); \
+#define LOOP_BODY(R, DATA, T)                                               \
+    }                                                                       \
+    else if (type == BOOST_PP_STRINGIZE(T)) {                               \
+        create_collection<BOOST_PP_CAT(T, _index)>(                         \
+            input_basename, params, output_filename, check, on_disk, type); \
         /**/
 
         BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
@@ -0,0 +1,55 @@
+#include <fstream>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include "binary_freq_collection.hpp"
+#include "binary_collection.hpp"
+#include "quantized_impacts.hpp"
+#include "util.hpp"
+
+// Writes a collection with the same documents and sizes as the input one,
+// whose frequencies are replaced by the quantized BM25 impacts of the
+// postings. Any index type built on it can be queried with the *_impact
+// query types.
+int main(int argc, const char** argv) {
+    using namespace ds2i;
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <collection basename> <output basename>" << std::endl;
+        return 1;
+    }
+
+    std::string input_basename = argv[1];
+    std::string output_basename = argv[2];
+
+    binary_collection sizes_coll((input_basename + ".sizes").c_str());
+    binary_freq_collection coll(input_basename.c_str());
+
+    logger() << "Computing max weight..." << std::endl;
+    impact_quantizer<> quantizer(sizes_coll.begin()->begin(), coll);
+    logger() << "An impact of 1 is worth " << quantizer.unit() << std::endl;
+
+    for (auto const& suffix : {".docs", ".sizes"}) {
+        boost::filesystem::copy_file(
+            input_basename + suffix, output_basename + suffix,
+            boost::filesystem::copy_option::overwrite_if_exists);
+    }
+
+    logger() << "Writing impacts..." << std::endl;
+    std::ofstream out(output_basename + ".freqs", std::ios::binary);
+    std::vector<uint32_t> impacts;
+    uint64_t sequences = 0;
+    for (auto const& seq: coll) {
+        quantizer.quantize(seq, impacts);
+        uint32_t n = impacts.size();
+        out.write(reinterpret_cast<char const*>(&n), sizeof(n));
+        out.write(reinterpret_cast<char const*>(impacts.data()),
+                  n * sizeof(impacts[0]));
+        if ((++sequences % 1000000) == 0) {
+            logger() << sequences << " list processed" << std::endl;
+        }
+    }
+    logger() << sequences << " list processed" << std::endl;
+}
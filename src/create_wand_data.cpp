@@ -5,23 +5,42 @@
 #include "binary_freq_collection.hpp"
 #include "binary_collection.hpp"
 #include "wand_data.hpp"
+#include "quantized_impacts.hpp"
 #include "util.hpp"
 
 int main(int argc, const char** argv) {
     using namespace ds2i;
 
-    if (argc != 3) {
+    if (argc < 3 or argc > 5) {
         std::cerr << "Usage: " << argv[0]
-                  << " <collection basename> <output filename>" << std::endl;
+                  << " <collection basename> <output filename>"
+                  << " [block size] [--impacts]" << std::endl;
         return 1;
     }
 
     std::string input_basename = argv[1];
     const char* output_filename = argv[2];
+    uint64_t block_size = wand_data<>::default_block_size;
+    // the collection was written by create_impact_collection
+    bool impacts = false;
+    for (int i = 3; i < argc; ++i) {
+        if (std::string(argv[i]) == "--impacts") {
+            impacts = true;
+        } else {
+            block_size = std::stoull(argv[i]);
+        }
+    }
 
     binary_collection sizes_coll((input_basename + ".sizes").c_str());
     binary_freq_collection coll(input_basename.c_str());
 
-    wand_data<> wdata(sizes_coll.begin()->begin(), coll.num_docs(), coll);
-    succinct::mapper::freeze(wdata, output_filename);
+    if (impacts) {
+        wand_data<quantized_impact> wdata(sizes_coll.begin()->begin(),
+                                          coll.num_docs(), coll, block_size);
+        succinct::mapper::freeze(wdata, output_filename);
+    } else {
+        wand_data<> wdata(sizes_coll.begin()->begin(), coll.num_docs(), coll,
+                          block_size);
+        succinct::mapper::freeze(wdata, output_filename);
+    }
 }
@@ -6,6 +6,7 @@
 #include <succinct/mapper.hpp>
 
 #include "index_types.hpp"
+#include "intersection.hpp"
 #include "util.hpp"
 
 typedef uint32_t term_id_type;
@@ -25,6 +26,9 @@ bool read_query(term_id_vec& ret, std::istream& is = std::cin) {
     return true;
 }
 
+enum class intersection_algorithm { automatic, leapfrog, skewed };
+intersection_algorithm algorithm = intersection_algorithm::automatic;
+
 template <typename Enum>
 static uint64_t intersect(uint64_t num_docs, std::vector<Enum>& enums,
                           std::vector<uint32_t>& out) {
@@ -34,28 +38,15 @@ static uint64_t intersect(uint64_t num_docs, std::vector<Enum>& enums,
     }
 
     uint64_t results = 0;
-    uint64_t candidate = enums[0].docid();
-    size_t i = 1;
-    while (candidate < num_docs) {
-        for (; i < 2; ++i) {
-            enums[i].next_geq(candidate);
-            if (enums[i].docid() != candidate) {
-                candidate = enums[i].docid();
-                i = 0;
-                break;
-            }
-        }
-
-        if (i == 2) {
-            out[results] = candidate;
-            ++results;
-            enums[0].next();
-            candidate = enums[0].docid();
-            i = 1;
-        }
+    auto append = [&](uint64_t docid) { out[results++] = docid; };
+    switch (algorithm) {
+        case intersection_algorithm::leapfrog:
+            return ds2i::leapfrog_intersect(enums, num_docs, append);
+        case intersection_algorithm::skewed:
+            return ds2i::skewed_intersect(enums, num_docs, append);
+        default:
+            return ds2i::intersect(enums, num_docs, append);
     }
-
-    return results;
 }
 
 template <typename Index>
@@ -81,7 +72,24 @@ void perftest(const char* index_filename) {
     uint64_t num_docs = index.num_docs();
     std::vector<uint32_t> out(num_docs);
 
+    // queries are grouped by the ratio between the lengths of their lists,
+    // in buckets [1, 4), [4, 16), ..., [4^(num_buckets - 1), inf)
+    static const uint32_t num_buckets = 6;
+    std::vector<std::vector<uint32_t>> buckets(num_buckets);
+    for (uint32_t i = 0; i != num_queries; ++i) {
+        uint64_t l = index[queries[i][0]].size();
+        uint64_t r = index[queries[i][1]].size();
+        uint64_t ratio = std::max(l, r) / std::max<uint64_t>(1, std::min(l, r));
+        uint32_t bucket = 0;
+        while (bucket + 1 != num_buckets and ratio >= 4) {
+            ratio /= 4;
+            ++bucket;
+        }
+        buckets[bucket].push_back(i);
+    }
+
     double total_usecs = 0.0;
+    std::vector<double> bucket_usecs(num_buckets, 0.0);
     // first run if for warming up
     static const int runs = 10 + 1;
     size_t total = 0;
@@ -90,19 +98,22 @@ void perftest(const char* index_filename) {
     std::vector<enum_type> qq;
     qq.reserve(2);
     for (int run = 0; run != runs; ++run) {
-        double start = get_time_usecs();
-        for (uint32_t i = 0; i != num_queries; ++i) {
-            qq.clear();
-            for (auto term : queries[i]) {
-                qq.push_back(index[term]);
+        for (uint32_t b = 0; b != num_buckets; ++b) {
+            double start = get_time_usecs();
+            for (auto i : buckets[b]) {
+                qq.clear();
+                for (auto term : queries[i]) {
+                    qq.push_back(index[term]);
+                }
+                uint64_t size = intersect(num_docs, qq, out);
+                total += size;
+            }
+            double end = get_time_usecs();
+            double elapsed = end - start;
+            if (run) {
+                total_usecs += elapsed;
+                bucket_usecs[b] += elapsed;
             }
-            uint64_t size = intersect(num_docs, qq, out);
-            total += size;
-        }
-        double end = get_time_usecs();
-        double elapsed = end - start;
-        if (run) {
-            total_usecs += elapsed;
         }
     }
 
@@ -117,6 +128,18 @@ void perftest(const char* index_filename) {
         "\t %lf [musecs] per intersection (avg. among %d "
         "queries)\n",
         total_usecs / (runs - 1) / num_queries, num_queries);
+    for (uint32_t b = 0, lo = 1; b != num_buckets; ++b, lo *= 4) {
+        if (buckets[b].empty()) continue;
+        printf("\t\t length ratio in [%u, ", lo);
+        if (b + 1 == num_buckets) {
+            printf("inf)");
+        } else {
+            printf("%u)", lo * 4);
+        }
+        printf(": %lf [musecs] per intersection (%zu queries)\n",
+               bucket_usecs[b] / (runs - 1) / buckets[b].size(),
+               buckets[b].size());
+    }
 }
 
 int main(int argc, const char** argv) {
@@ -124,7 +147,8 @@ int main(int argc, const char** argv) {
 
     int mandatory = 3;
     if (argc < mandatory) {
-        std::cerr << argv[0] << " <index_type> <index_filename> < query_log"
+        std::cerr << argv[0] << " <index_type> <index_filename>"
+                  << " [--algorithm auto|leapfrog|skewed] < query_log"
                   << std::endl;
         return 1;
     }
@@ -132,6 +156,26 @@ int main(int argc, const char** argv) {
     std::string index_type = argv[1];
     const char* index_filename = argv[2];
 
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--algorithm" and i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "auto") {
+                algorithm = intersection_algorithm::automatic;
+            } else if (name == "leapfrog") {
+                algorithm = intersection_algorithm::leapfrog;
+            } else if (name == "skewed") {
+                algorithm = intersection_algorithm::skewed;
+            } else {
+                logger() << "ERROR: Unknown algorithm " << name << std::endl;
+                return 1;
+            }
+        } else {
+            logger() << "ERROR: Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
     if (false) {
 #define LOOP_BODY(R, DATA, T)                              \
     }                                                      \
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -8,10 +10,128 @@
 #include "index_types.hpp"
 #include "wand_data.hpp"
 #include "queries.hpp"
+#include "work_stealing_pool.hpp"
+#include "configuration.hpp"
 #include "util.hpp"
 
 const size_t runs = 10 + 1;
 
+// Set with --threads and --pin: when thread counts are given, each query
+// type is run in throughput mode once per thread count instead of serially.
+struct throughput_options {
+    std::vector<size_t> threads;
+    bool pin = false;
+};
+throughput_options throughput;
+
+void pin_to_cpu(std::thread& t, size_t cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % std::thread::hardware_concurrency(), &set);
+    if (pthread_setaffinity_np(t.native_handle(), sizeof(set), &set)) {
+        ds2i::logger() << "Could not pin thread to CPU " << cpu << std::endl;
+    }
+#else
+    (void)t;
+    (void)cpu;
+#endif
+}
+
+// Runs the query log [runs] times on [num_threads] threads sharing the
+// index, each with its own copy of the operator; the queries are handed
+// out from a shared counter, and the latencies of the first run are not
+// recorded. Reports the throughput, the latency quantiles and the
+// throughput per thread relative to [base_qps_per_thread] (0 for the first
+// thread count); returns the throughput per thread.
+template <typename QueryOperator, typename IndexType>
+double op_throughput(IndexType const& index, QueryOperator const& query_op,
+                     std::vector<ds2i::term_id_vec> const& queries,
+                     std::string const& index_type,
+                     std::string const& query_type, size_t runs,
+                     size_t num_threads, double base_qps_per_thread) {
+    using namespace ds2i;
+
+    // no latencies to report
+    if (queries.empty()) {
+        return 0;
+    }
+
+    std::vector<std::vector<double>> thread_times(num_threads);
+    std::vector<size_t> thread_totals(num_threads, 0);
+    std::atomic<size_t> next_query(0);
+    size_t warmup_queries = queries.size();
+    size_t total_queries = queries.size() * runs;
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> start(false);
+
+    auto worker = [&](size_t thread_id) {
+        QueryOperator op(query_op);
+        auto& times = thread_times[thread_id];
+        times.reserve(total_queries / num_threads + 1);
+        ready += 1;
+        while (!start) {
+            std::this_thread::yield();
+        }
+        size_t i;
+        size_t total = 0;
+        while ((i = next_query++) < total_queries) {
+            auto tick = get_time_usecs();
+            total += op(index, queries[i % queries.size()]);
+            double elapsed = double(get_time_usecs() - tick);
+            if (i >= warmup_queries) {
+                times.push_back(elapsed);
+            }
+        }
+        thread_totals[thread_id] = total;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t != num_threads; ++t) {
+        threads.emplace_back(worker, t);
+        if (throughput.pin) {
+            pin_to_cpu(threads.back(), t);
+        }
+    }
+    while (ready != num_threads) {
+        std::this_thread::yield();
+    }
+    // NOTE: the throughput is measured over all the runs, warmup included
+    // (the lists are already warmed up by perftest)
+    double tick = get_time_usecs();
+    start = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    double elapsed_secs = (get_time_usecs() - tick) / 1000000;
+
+    std::vector<double> query_times;
+    size_t total = 0;
+    for (size_t t = 0; t != num_threads; ++t) {
+        query_times.insert(query_times.end(), thread_times[t].begin(),
+                           thread_times[t].end());
+        total += thread_totals[t];
+    }
+    std::cout << total << std::endl;
+
+    std::sort(query_times.begin(), query_times.end());
+    auto quantile = [&](double q) {
+        return query_times[size_t(q * (query_times.size() - 1))];
+    };
+    double qps = total_queries / elapsed_secs;
+    double qps_per_thread = qps / num_threads;
+    double scaling = base_qps_per_thread ? qps_per_thread / base_qps_per_thread
+                                         : 1.0;
+
+    stats_line()("type", index_type)("query", query_type)(
+        "threads", num_threads)("pinned", throughput.pin)("qps", qps)(
+        "qps_per_thread", qps_per_thread)("scaling", scaling)(
+        "q50", quantile(0.5))("q90", quantile(0.9))("q99", quantile(0.99))(
+        "q999", quantile(0.999));
+
+    return qps_per_thread;
+}
+
 template <typename QueryOperator, typename IndexType>
 void op_perftest(IndexType const& index,
                  QueryOperator&& query_op,  // XXX!!!
@@ -20,6 +140,20 @@ void op_perftest(IndexType const& index,
                  size_t runs) {
     using namespace ds2i;
 
+    if (!throughput.threads.empty()) {
+        double base_qps_per_thread = 0;
+        for (size_t num_threads : throughput.threads) {
+            double qps_per_thread =
+                op_throughput(index, query_op, queries, index_type,
+                              query_type, runs, num_threads,
+                              base_qps_per_thread);
+            if (!base_qps_per_thread) {
+                base_qps_per_thread = qps_per_thread;
+            }
+        }
+        return;
+    }
+
     std::vector<double> query_times;
     size_t total = 0;
     for (size_t run = 0; run != runs; ++run) {
@@ -82,12 +216,38 @@ void perftest(const char* index_filename, const char* wand_data_filename,
         }
     }
 
-    wand_data<> wdata;
+    // the wand data holds the weights of a single scorer, which is checked
+    // when mapping it, so it is mapped only for the scorers of the query
+    // types that use it: bm25, or quantized_impact for the *_impact ones
     boost::iostreams::mapped_file_source md;
     if (wand_data_filename) {
         md.open(wand_data_filename);
-        succinct::mapper::map(wdata, md, succinct::mapper::map_flags::warmup);
     }
+    wand_data<> wdata;
+    wand_data<quantized_impact> impact_wdata;
+    bool bm25_mapped = false;
+    bool impact_mapped = false;
+    auto bm25_data = [&]() -> wand_data<> const& {
+        if (!bm25_mapped) {
+            succinct::mapper::map(wdata, md,
+                                  succinct::mapper::map_flags::warmup);
+            bm25_mapped = true;
+        }
+        return wdata;
+    };
+    auto impact_data = [&]() -> wand_data<quantized_impact> const& {
+        if (!impact_mapped) {
+            succinct::mapper::map(impact_wdata, md,
+                                  succinct::mapper::map_flags::warmup);
+            impact_mapped = true;
+        }
+        return impact_wdata;
+    };
+
+    // used by the parallel_* query types; the thread running a query works
+    // on it too, so the pool has one thread less than DS2I_THREADS
+    work_stealing_pool pool(
+        std::max<size_t>(configuration::get().worker_threads, 1) - 1);
 
     std::vector<std::string> query_types;
     boost::algorithm::split(query_types, query_type, boost::is_any_of(":"));
@@ -97,33 +257,74 @@ void perftest(const char* index_filename, const char* wand_data_filename,
             op_perftest(index, and_query<false>(), queries, type, t, runs);
         } else if (t == "and_freq") {
             op_perftest(index, and_query<true>(), queries, type, t, runs);
+        } else if (t == "parallel_and") {
+            op_perftest(index, parallel_and_query<false>(pool), queries, type,
+                        t, runs);
+        } else if (t == "parallel_and_freq") {
+            op_perftest(index, parallel_and_query<true>(pool), queries, type,
+                        t, runs);
         } else if (t == "or") {
             op_perftest(index, or_query<false>(), queries, type, t, runs);
         } else if (t == "or_freq") {
             op_perftest(index, or_query<true>(), queries, type, t, runs);
+        } else if (t == "block_or") {
+            op_perftest(index, block_or_query<false>(), queries, type, t,
+                        runs);
+        } else if (t == "block_or_freq") {
+            op_perftest(index, block_or_query<true>(), queries, type, t,
+                        runs);
         } else if (t == "wand" && wand_data_filename) {
-            op_perftest(index, wand_query(wdata, 10), queries, type, t, runs);
+            op_perftest(index, wand_query<>(bm25_data(), 10), queries, type,
+                        t, runs);
+        } else if (t == "wand_impact" && wand_data_filename) {
+            op_perftest(index, wand_query<quantized_impact>(impact_data(), 10),
+                        queries, type, t, runs);
         } else if (t == "ranked_and" && wand_data_filename) {
-            op_perftest(index, ranked_and_query(wdata, 10), queries, type, t,
-                        runs);
+            op_perftest(index, ranked_and_query(bm25_data(), 10), queries,
+                        type, t, runs);
+        } else if (t == "ranked_or" && wand_data_filename) {
+            op_perftest(index, ranked_or_query<>(bm25_data(), 10), queries,
+                        type, t, runs);
+        } else if (t == "ranked_or_impact" && wand_data_filename) {
+            op_perftest(index,
+                        ranked_or_query<quantized_impact>(impact_data(), 10),
+                        queries, type, t, runs);
+        } else if (t == "parallel_ranked_or" && wand_data_filename) {
+            op_perftest(index,
+                        parallel_ranked_or_query<>(pool, bm25_data(), 10),
+                        queries, type, t, runs);
+        } else if (t == "block_ranked_or" && wand_data_filename) {
+            op_perftest(index, block_ranked_or_query(bm25_data(), 10),
+                        queries, type, t, runs);
         } else if (t == "maxscore" && wand_data_filename) {
-            op_perftest(index, maxscore_query(wdata, 10), queries, type, t,
-                        runs);
+            op_perftest(index, maxscore_query(bm25_data(), 10), queries, type,
+                        t, runs);
+        } else if (t == "block_max_wand" && wand_data_filename) {
+            op_perftest(index, block_max_wand_query(bm25_data(), 10),
+                        queries, type, t, runs);
+        } else if (t == "block_max_maxscore" && wand_data_filename) {
+            op_perftest(index, block_max_maxscore_query(bm25_data(), 10),
+                        queries, type, t, runs);
         } else {
             logger() << "Unsupported query type: " << t << std::endl;
         }
     }
 }
 
+void print_usage(const char* name) {
+    std::cerr << name
+              << " <index_type> <query_type> <index_filename> "
+                 "[wand_filename] [--threads <n1,n2,...>] [--pin] "
+                 "< query_log"
+              << std::endl;
+}
+
 int main(int argc, const char** argv) {
     using namespace ds2i;
 
     int mandatory = 4;
     if (argc < mandatory) {
-        std::cerr << argv[0]
-                  << " <index_type> <query_type> <index_filename> "
-                     "[wand_filename] < query_log"
-                  << std::endl;
+        print_usage(argv[0]);
         return 1;
     }
 
@@ -132,15 +333,49 @@ int main(int argc, const char** argv) {
     const char* index_filename = argv[3];
     const char* wand_data_filename = nullptr;
 
-    if (argc > mandatory) {
-        wand_data_filename = argv[mandatory];
+    for (int i = mandatory; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" and i + 1 < argc) {
+            std::vector<std::string> counts;
+            boost::algorithm::split(counts, argv[++i],
+                                    boost::is_any_of(","));
+            for (auto const& count : counts) {
+                size_t num_threads = 0;
+                try {
+                    size_t end = 0;
+                    num_threads = std::stoull(count, &end);
+                    if (end != count.size()) {
+                        num_threads = 0;
+                    }
+                } catch (std::logic_error const&) {
+                    // left 0, reported below
+                }
+                if (!num_threads) {
+                    logger() << "ERROR: invalid thread count " << count
+                             << std::endl;
+                    return 1;
+                }
+                throughput.threads.push_back(num_threads);
+            }
+        } else if (arg == "--pin") {
+            throughput.pin = true;
+        } else if (i == mandatory and arg.compare(0, 2, "--") != 0) {
+            wand_data_filename = argv[i];
+        } else {
+            // unknown flags, --threads without a value and misplaced
+            // filenames
+            print_usage(argv[0]);
+            return 1;
+        }
     }
 
     std::vector<term_id_vec> queries;
     term_id_vec q;
     while (read_query(q)) queries.push_back(q);
 
-    if (false) {
+    // NOTE: mapping wand data built for another scorer throws
+    try {
+        if (false) {
 #define LOOP_BODY(R, DATA, T)                                                 \
     }                                                                         \
     else if (type == BOOST_PP_STRINGIZE(T)) {                                 \
@@ -148,10 +383,14 @@ int main(int argc, const char** argv) {
                                           queries, type, query_type);         \
         /**/
 
-        BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
+            BOOST_PP_SEQ_FOR_EACH(LOOP_BODY, _, DS2I_INDEX_TYPES);
 #undef LOOP_BODY
-    } else {
-        logger() << "ERROR: Unknown type " << type << std::endl;
+        } else {
+            logger() << "ERROR: Unknown type " << type << std::endl;
+        }
+    } catch (std::runtime_error const& e) {
+        logger() << "ERROR: " << e.what() << std::endl;
+        return 1;
     }
 
     return 0;
@@ -5,39 +5,48 @@
 #include "block_freq_index.hpp"
 #include "block_codecs.hpp"
 #include <succinct/mapper.hpp>
+#include <boost/filesystem.hpp>
 
 #include <vector>
 #include <cstdlib>
 #include <algorithm>
 
 template <typename BlockCodec>
-void test_block_freq_index()
+void test_block_freq_index(bool on_disk = false)
 {
     ds2i::global_parameters params;
     uint64_t universe = 20000;
     typedef ds2i::block_freq_index<BlockCodec> collection_type;
-    typename collection_type::builder b(universe, params);
 
     typedef std::vector<uint64_t> vec_type;
     std::vector<std::pair<vec_type, vec_type>> posting_lists(30);
-    for (auto& plist: posting_lists) {
-        double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
-        uint64_t n = uint64_t(universe / avg_gap);
-        plist.first = random_sequence(universe, n, true);
-        plist.second.resize(n);
-        std::generate(plist.second.begin(), plist.second.end(),
-                      []() { return (rand() % 256) + 1; });
+    {
+        typename collection_type::builder b(universe, params);
+        if (on_disk) {
+            // as with --on-disk, the lists of the index built are mapped
+            // from this file
+            b.spill_lists_to("temp.lists");
+        }
 
-        b.add_posting_list(n, plist.first.begin(),
-                           plist.second.begin(), 0);
+        for (auto& plist: posting_lists) {
+            double avg_gap = 1.1 + double(rand()) / RAND_MAX * 10;
+            uint64_t n = uint64_t(universe / avg_gap);
+            plist.first = random_sequence(universe, n, true);
+            plist.second.resize(n);
+            std::generate(plist.second.begin(), plist.second.end(),
+                          []() { return (rand() % 256) + 1; });
 
-    }
+            b.add_posting_list(n, plist.first.begin(),
+                               plist.second.begin(), 0);
+
+        }
 
-    {
         collection_type coll;
         b.build(coll);
         succinct::mapper::freeze(coll, "temp.bin");
     }
+    // the file of the lists is removed with the builder
+    BOOST_REQUIRE(!boost::filesystem::exists("temp.lists"));
 
     {
         collection_type coll;
@@ -69,3 +78,9 @@ BOOST_AUTO_TEST_CASE(block_freq_index)
     test_block_freq_index<ds2i::simple16_block>();
     test_block_freq_index<ds2i::u32_block>();
 }
+
+BOOST_AUTO_TEST_CASE(block_freq_index_on_disk)
+{
+    test_block_freq_index<ds2i::optpfor_block>(true);
+    test_block_freq_index<ds2i::interpolative_block>(true);
+}
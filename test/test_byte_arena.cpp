@@ -0,0 +1,85 @@
+#define BOOST_TEST_MODULE byte_arena
+
+#include "succinct/test_common.hpp"
+
+#include "byte_arena.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+BOOST_AUTO_TEST_CASE(byte_arena)
+{
+    srand(42);
+    std::vector<uint8_t> expected;
+    ds2i::byte_arena arena(1 << 10);
+    for (size_t i = 0; i < 2000; ++i) {
+        // mostly small appends, some larger than a chunk
+        size_t n = (i % 100 == 0) ? (rand() % 4096) : (rand() % 64);
+        std::vector<uint8_t> bytes(n);
+        for (auto& b: bytes) {
+            b = uint8_t(rand());
+        }
+        expected.insert(expected.end(), bytes.begin(), bytes.end());
+        if (i % 2) {
+            arena.append(bytes.begin(), bytes.end());
+        } else {
+            arena.append(std::move(bytes));
+        }
+        BOOST_REQUIRE_EQUAL(expected.size(), arena.size());
+    }
+
+    std::vector<uint8_t> out;
+    arena.release(out);
+    BOOST_REQUIRE_EQUAL(0, arena.size());
+    BOOST_REQUIRE(out == expected);
+}
+
+BOOST_AUTO_TEST_CASE(byte_arena_small)
+{
+    // the capacity of a single chunk is not kept by the released bytes
+    ds2i::byte_arena arena(1 << 20);
+    std::vector<uint8_t> bytes(100, 42);
+    arena.append(bytes.begin(), bytes.end());
+
+    std::vector<uint8_t> out;
+    arena.release(out);
+    BOOST_REQUIRE(out == bytes);
+    BOOST_REQUIRE_LT(out.capacity(), 1 << 20);
+}
+
+BOOST_AUTO_TEST_CASE(byte_arena_spill)
+{
+    srand(42);
+    const char* filename = "temp_arena.bin";
+    std::vector<uint8_t> expected;
+    {
+        ds2i::byte_arena arena(1 << 10);
+        // a few appends are kept in memory between the spills
+        arena.spill_to(filename, 3000);
+        BOOST_REQUIRE(boost::filesystem::exists(filename));
+        for (size_t i = 0; i < 2000; ++i) {
+            size_t n = (i % 100 == 0) ? (rand() % 4096) : (rand() % 64);
+            std::vector<uint8_t> bytes(n);
+            for (auto& b: bytes) {
+                b = uint8_t(rand());
+            }
+            expected.insert(expected.end(), bytes.begin(), bytes.end());
+            if (i % 2) {
+                arena.append(bytes.begin(), bytes.end());
+            } else {
+                arena.append(std::move(bytes));
+            }
+            BOOST_REQUIRE_EQUAL(expected.size(), arena.size());
+        }
+
+        succinct::mapper::mappable_vector<uint8_t> out;
+        arena.release(out);
+        BOOST_REQUIRE_EQUAL(expected.size(), out.size());
+        BOOST_REQUIRE(std::equal(expected.begin(), expected.end(),
+                                 out.begin()));
+    }
+    // the file is removed with the arena
+    BOOST_REQUIRE(!boost::filesystem::exists(filename));
+}
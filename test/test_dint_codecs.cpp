@@ -0,0 +1,86 @@
+#define BOOST_TEST_MODULE dint_codecs
+
+#include "succinct/test_common.hpp"
+#include "block_codecs.hpp"
+#include "dint_codecs.hpp"
+#include "dictionary_types.hpp"
+#include <vector>
+#include <cstdlib>
+#include <random>
+
+template <typename Dictionary, typename Generator>
+void build_dictionary(typename Dictionary::builder& builder, Generator& gen)
+{
+    std::mt19937 rng(12345);
+    builder.init();
+    for (uint32_t i = 0; i != 4096; ++i) {
+        uint32_t entry_size = uint32_t(1) << (rng() % 5);
+        std::vector<uint32_t> entry(entry_size);
+        std::generate(entry.begin(), entry.end(), [&]() { return gen(rng); });
+        builder.append(entry.data(), entry_size,
+                       i % ds2i::constants::num_selectors);
+    }
+    builder.build();
+    builder.prepare_for_encoding();
+}
+
+template <typename Dictionary, typename Coder>
+void test_dint_codec()
+{
+    // mostly small values, with zero runs and both kinds of exceptions
+    auto gen = [](std::mt19937& rng) -> uint32_t {
+        uint32_t k = rng() % 10;
+        if (k < 6) return rng() % 4;
+        if (k < 7) return rng() % 100000;
+        if (k < 9) return 0;
+        return rng() % 1000;
+    };
+
+    typename Dictionary::builder builder;
+    build_dictionary<Dictionary>(builder, gen);
+
+    std::vector<size_t> sizes = {1, 16, Coder::block_size - 1, Coder::block_size};
+    std::vector<std::vector<uint32_t>> values;
+    std::vector<std::vector<uint8_t>> encoded;
+    std::mt19937 rng(42);
+    for (size_t tcase = 0; tcase < 100; ++tcase) {
+        for (auto size: sizes) {
+            values.emplace_back(size);
+            std::generate(values.back().begin(), values.back().end(),
+                          [&]() { return gen(rng); });
+            encoded.emplace_back();
+            Coder::encode(builder, values.back().data(), uint32_t(-1),
+                          size, encoded.back());
+        }
+    }
+
+    Dictionary dict;
+    builder.build(dict);
+
+    for (size_t i = 0; i < values.size(); ++i) {
+        std::vector<uint32_t> decoded(values[i].size() + Coder::overflow, 0);
+        uint8_t const* out = Coder::decode(dict, encoded[i].data(), decoded.data(),
+                                           uint32_t(-1), values[i].size());
+        BOOST_REQUIRE_EQUAL(encoded[i].size(), out - encoded[i].data());
+        BOOST_REQUIRE_EQUAL_COLLECTIONS(values[i].begin(), values[i].end(),
+                                        decoded.begin(), decoded.begin() + values[i].size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dint_codecs)
+{
+    test_dint_codec<ds2i::single_dictionary_packed_type,
+                    ds2i::opt_dint_single_dict_block>();
+    test_dint_codec<ds2i::single_dictionary_packed_type,
+                    ds2i::greedy_dint_single_dict_block>();
+    test_dint_codec<ds2i::single_dictionary_rectangular_type,
+                    ds2i::opt_dint_single_dict_block>();
+    test_dint_codec<ds2i::single_dictionary_overlapped_type,
+                    ds2i::opt_dint_single_dict_block>();
+    test_dint_codec<ds2i::multi_dictionary_packed_type,
+                    ds2i::opt_dint_multi_dict_block>();
+    test_dint_codec<ds2i::single_dictionary_packed_type,
+                    ds2i::opt_dint_single_dict_exceptions_block>();
+    test_dint_codec<ds2i::single_dictionary_rectangular_type,
+                    ds2i::opt_dint_single_dict_exceptions_block>();
+}
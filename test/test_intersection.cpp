@@ -0,0 +1,137 @@
+#define BOOST_TEST_MODULE intersection
+
+#include "succinct/test_common.hpp"
+
+#include "block_posting_list.hpp"
+#include "block_codecs.hpp"
+#include "intersection.hpp"
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+typedef ds2i::block_posting_list<ds2i::optpfor_block> posting_list_type;
+typedef posting_list_type::document_enumerator enum_type;
+
+// [n] random docids below [universe], including all the [common] ones
+std::vector<uint64_t> random_list(uint64_t n, uint64_t universe,
+                                  std::vector<uint64_t> const& common)
+{
+    std::vector<uint64_t> docs(common);
+    while (docs.size() < n) {
+        docs.push_back(rand() % universe);
+    }
+    std::sort(docs.begin(), docs.end());
+    docs.erase(std::unique(docs.begin(), docs.end()), docs.end());
+    return docs;
+}
+
+template <typename Intersect>
+void test_intersection(std::vector<std::vector<uint8_t>> const& data,
+                       uint64_t universe, uint64_t end,
+                       std::vector<uint64_t> const& expected,
+                       Intersect intersect)
+{
+    std::vector<enum_type> enums;
+    for (auto const& list: data) {
+        enums.emplace_back(list.data(), universe);
+    }
+
+    std::vector<uint64_t> results;
+    uint64_t count = intersect(enums, end, [&](uint64_t docid) {
+        results.push_back(docid);
+    });
+    BOOST_REQUIRE_EQUAL(results.size(), count);
+    BOOST_REQUIRE_EQUAL(expected.size(), results.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        MY_REQUIRE_EQUAL(expected[i], results[i],
+                         "i = " << i << " end = " << end);
+    }
+}
+
+void test_intersections(std::vector<uint64_t> const& sizes)
+{
+    uint64_t universe = 1 << 20;
+    std::vector<uint64_t> common = random_list(sizes[0] / 2, universe, {});
+
+    // the lists must be sorted by increasing size
+    std::vector<std::vector<uint64_t>> lists;
+    for (auto size: sizes) {
+        lists.push_back(random_list(size, universe, common));
+    }
+    std::sort(lists.begin(), lists.end(),
+              [](std::vector<uint64_t> const& lhs,
+                 std::vector<uint64_t> const& rhs) {
+                  return lhs.size() < rhs.size();
+              });
+
+    std::vector<uint64_t> all(lists[0]);
+    std::vector<std::vector<uint8_t>> data;
+    for (auto const& docs: lists) {
+        std::vector<uint64_t> freqs(docs.size(), 1);
+        data.emplace_back();
+        posting_list_type::write(data.back(), docs.size(), docs.begin(),
+                                 freqs.begin());
+
+        std::vector<uint64_t> tmp;
+        std::set_intersection(all.begin(), all.end(), docs.begin(), docs.end(),
+                              std::back_inserter(tmp));
+        all.swap(tmp);
+    }
+
+    // unbounded, bounded in the middle of the results, on a result, and
+    // before all of them
+    std::vector<uint64_t> ends = {universe, universe / 3, 0};
+    if (!all.empty()) {
+        ends.push_back(all[all.size() / 2]);
+    }
+
+    for (auto end: ends) {
+        std::vector<uint64_t> expected(
+            all.begin(), std::lower_bound(all.begin(), all.end(), end));
+
+        test_intersection(data, universe, end, expected,
+                          [](std::vector<enum_type>& enums, uint64_t end,
+                             auto&& f) {
+                              return ds2i::leapfrog_intersect(enums, end, f);
+                          });
+        test_intersection(data, universe, end, expected,
+                          [](std::vector<enum_type>& enums, uint64_t end,
+                             auto&& f) {
+                              return ds2i::skewed_intersect(
+                                  enums, end, f, (enum_type*)nullptr, 0);
+                          });
+        // prefetch distances shorter and longer than the shortest list
+        for (uint64_t distance: {1, 8, 100000}) {
+            test_intersection(data, universe, end, expected,
+                              [=](std::vector<enum_type>& enums, uint64_t end,
+                                  auto&& f) {
+                                  enum_type ahead = enums[0];
+                                  return ds2i::skewed_intersect(
+                                      enums, end, f, &ahead, distance);
+                              });
+        }
+        test_intersection(data, universe, end, expected,
+                          [](std::vector<enum_type>& enums, uint64_t end,
+                             auto&& f) {
+                              return ds2i::skewed_intersect(enums, end, f);
+                          });
+        test_intersection(data, universe, end, expected,
+                          [](std::vector<enum_type>& enums, uint64_t end,
+                             auto&& f) {
+                              return ds2i::intersect(enums, end, f);
+                          });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(intersection)
+{
+    srand(42);
+    test_intersections({1000, 1000});
+    test_intersections({1000, 5000, 20000});
+    test_intersections({100, 300000});
+    test_intersections({10, 50000, 400000});
+    test_intersections({1, 200000});
+    test_intersections({2000});
+}
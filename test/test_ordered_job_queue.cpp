@@ -0,0 +1,85 @@
+#define BOOST_TEST_MODULE ordered_job_queue
+
+#include "succinct/test_common.hpp"
+
+#include "ordered_job_queue.hpp"
+
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+struct append_job : ds2i::ordered_job_queue::job {
+    append_job(std::vector<uint64_t>& out, uint64_t id, uint64_t work)
+        : out(out)
+        , id(id)
+        , work(work)
+        , result(0)
+    {}
+
+    virtual void prepare()
+    {
+        if (work == uint64_t(-1)) {
+            throw std::runtime_error("prepare failed");
+        }
+        // some work proportional to the expected one
+        uint64_t x = id;
+        for (uint64_t i = 0; i < work; ++i) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+        result = x;
+    }
+
+    virtual void commit()
+    {
+        out.push_back(id);
+    }
+
+    std::vector<uint64_t>& out;
+    uint64_t id;
+    uint64_t work;
+    uint64_t result;
+};
+
+BOOST_AUTO_TEST_CASE(ordered_job_queue)
+{
+    srand(42);
+    std::vector<uint64_t> out;
+    {
+        // a small window, so that add_job() has to commit along the way
+        ds2i::ordered_job_queue queue(1 << 20);
+        for (uint64_t id = 0; id < 10000; ++id) {
+            // a few jobs much larger than the others
+            uint64_t work = (id % 1000 == 0) ? (1 << 19) : (rand() % 1000);
+            queue.add_job(std::make_shared<append_job>(out, id, work), work);
+        }
+        queue.complete();
+    }
+
+    BOOST_REQUIRE_EQUAL(10000, out.size());
+    for (uint64_t id = 0; id < out.size(); ++id) {
+        MY_REQUIRE_EQUAL(id, out[id], "id = " << id);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ordered_job_queue_exception)
+{
+    std::vector<uint64_t> out;
+    ds2i::ordered_job_queue queue;
+    bool thrown = false;
+    try {
+        for (uint64_t id = 0; id < 100; ++id) {
+            uint64_t work = (id == 50) ? uint64_t(-1) : 100;
+            queue.add_job(std::make_shared<append_job>(out, id, work), 100);
+        }
+        queue.complete();
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+
+    BOOST_REQUIRE(thrown);
+    // the jobs before the failed one have been committed in order
+    BOOST_REQUIRE_EQUAL(50, out.size());
+    for (uint64_t id = 0; id < out.size(); ++id) {
+        MY_REQUIRE_EQUAL(id, out[id], "id = " << id);
+    }
+}
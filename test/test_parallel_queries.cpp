@@ -0,0 +1,145 @@
+#define BOOST_TEST_MODULE parallel_queries
+
+#include "succinct/test_common.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdlib>
+
+#include "index_types.hpp"
+#include "queries.hpp"
+
+namespace ds2i { namespace test {
+
+    // A random collection whose longest lists are split in several docid
+    // ranges by docid_ranges(), so that the parallel queries evaluate more
+    // than one range per list.
+    struct parallel_initialization {
+
+        typedef single_index index_type;
+
+        parallel_initialization()
+            : basename(write_collection())
+            , collection(basename.c_str())
+            , document_sizes((basename + ".sizes").c_str())
+            , wdata(document_sizes.begin()->begin(), collection.num_docs(), collection)
+        {
+            index_type::builder builder(collection.num_docs(), params);
+            for (auto const& plist: collection) {
+                uint64_t freqs_sum = std::accumulate(plist.freqs.begin(),
+                                                     plist.freqs.end(), uint64_t(0));
+                builder.add_posting_list(plist.docs.size(), plist.docs.begin(),
+                                         plist.freqs.begin(), freqs_sum);
+            }
+            builder.build(index);
+
+            // all the pairs of lists, a list with itself included
+            for (term_id_type i = 0; i < num_terms; ++i) {
+                queries.push_back({i});
+                for (term_id_type j = i; j < num_terms; ++j) {
+                    queries.push_back({i, j});
+                }
+            }
+            queries.push_back({0, 1, 2});
+            queries.push_back({1, 3, 4});
+        }
+
+        ~parallel_initialization()
+        {
+            for (auto ext: {".docs", ".freqs", ".sizes"}) {
+                boost::filesystem::remove(basename + ext);
+            }
+        }
+
+        static const uint64_t num_docs = 1 << 20;
+        static const uint64_t num_terms = 5;
+
+        static void write_sequence(std::ofstream& out,
+                                   std::vector<uint32_t> const& seq)
+        {
+            uint32_t n = seq.size();
+            out.write(reinterpret_cast<char const*>(&n), sizeof(n));
+            out.write(reinterpret_cast<char const*>(seq.data()),
+                      n * sizeof(seq[0]));
+        }
+
+        static std::string write_collection()
+        {
+            std::string basename =
+                (boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path()).string();
+            std::ofstream docs(basename + ".docs", std::ios::binary);
+            std::ofstream freqs(basename + ".freqs", std::ios::binary);
+            std::ofstream sizes(basename + ".sizes", std::ios::binary);
+
+            srand(42);
+            write_sequence(docs, {uint32_t(num_docs)});
+            // postings per million documents; the first list is longer
+            // than 8 * min_range_postings
+            uint64_t densities[num_terms] = {600000, 250000, 50000, 1000, 50};
+            for (uint64_t t = 0; t < num_terms; ++t) {
+                std::vector<uint32_t> list_docs, list_freqs;
+                for (uint32_t docid = 0; docid < num_docs; ++docid) {
+                    if (uint64_t(rand() % 1000000) < densities[t]) {
+                        list_docs.push_back(docid);
+                        list_freqs.push_back(1 + rand() % 10);
+                    }
+                }
+                write_sequence(docs, list_docs);
+                write_sequence(freqs, list_freqs);
+            }
+
+            std::vector<uint32_t> doc_sizes(num_docs);
+            for (auto& size: doc_sizes) {
+                size = 1 + rand() % 1000;
+            }
+            write_sequence(sizes, doc_sizes);
+            return basename;
+        }
+
+        std::string basename;
+        global_parameters params;
+        binary_freq_collection collection;
+        binary_collection document_sizes;
+        index_type index;
+        std::vector<term_id_vec> queries;
+        wand_data<> wdata;
+    };
+
+}}
+
+BOOST_FIXTURE_TEST_CASE(parallel_queries,
+                        ds2i::test::parallel_initialization)
+{
+    for (size_t workers: {0, 1, 3}) {
+        ds2i::work_stealing_pool pool(workers);
+        BOOST_REQUIRE_EQUAL(workers, pool.num_threads());
+        uint64_t max_ranges = 4 * (pool.num_threads() + 1);
+        BOOST_REQUIRE_LT(2U, ds2i::docid_ranges(index[0], index.num_docs(),
+                                                max_ranges).size());
+
+        ds2i::ranked_or_query<> or_q(wdata, 10);
+        ds2i::parallel_ranked_or_query<> parallel_or_q(pool, wdata, 10);
+        for (auto const& q: queries) {
+            MY_REQUIRE_EQUAL(ds2i::and_query<false>()(index, q),
+                             ds2i::parallel_and_query<false>(pool)(index, q),
+                             "workers = " << workers);
+            MY_REQUIRE_EQUAL(ds2i::and_query<true>()(index, q),
+                             ds2i::parallel_and_query<true>(pool)(index, q),
+                             "workers = " << workers);
+
+            or_q(index, q);
+            parallel_or_q(index, q);
+            BOOST_REQUIRE_EQUAL(or_q.topk().size(), parallel_or_q.topk().size());
+            for (size_t i = 0; i < or_q.topk().size(); ++i) {
+                // the documents are scored the same way in both
+                MY_REQUIRE_EQUAL(or_q.topk()[i].first,
+                                 parallel_or_q.topk()[i].first,
+                                 "workers = " << workers << " i = " << i);
+            }
+        }
+    }
+}
@@ -3,6 +3,9 @@
 #include "succinct/test_common.hpp"
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <functional>
+#include <limits>
+
 #include "ds2i_config.hpp"
 #include "index_types.hpp"
 #include "queries.hpp"
@@ -42,14 +45,22 @@ namespace ds2i { namespace test {
         template <typename QueryOp>
         void test_against_or(QueryOp& op_q) const
         {
-            ranked_or_query or_q(wdata, 10);
+            test_against_or(op_q, wdata);
+        }
+
+        template <typename QueryOp, typename Scorer>
+        void test_against_or(QueryOp& op_q,
+                             wand_data<Scorer> const& op_wdata) const
+        {
+            ranked_or_query<Scorer> or_q(op_wdata, 10);
 
             for (auto const& q: queries) {
                 or_q(index, q);
                 op_q(index, q);
                 BOOST_REQUIRE_EQUAL(or_q.topk().size(), op_q.topk().size());
                 for (size_t i = 0; i < or_q.topk().size(); ++i) {
-                    BOOST_REQUIRE_CLOSE(or_q.topk()[i], op_q.topk()[i], 0.1); // tolerance is % relative
+                    BOOST_REQUIRE_CLOSE(or_q.topk()[i].first,
+                                        op_q.topk()[i].first, 0.1); // tolerance is % relative
                 }
             }
         }
@@ -62,13 +73,150 @@ namespace ds2i { namespace test {
 BOOST_FIXTURE_TEST_CASE(wand,
                         ds2i::test::index_initialization)
 {
-    ds2i::wand_query wand_q(wdata, 10);
+    ds2i::wand_query<> wand_q(wdata, 10);
     test_against_or(wand_q);
 }
 
+// the frequencies of the collection are read as quantized impacts
+BOOST_FIXTURE_TEST_CASE(wand_impact,
+                        ds2i::test::index_initialization)
+{
+    ds2i::wand_data<ds2i::quantized_impact>
+        impact_wdata(document_sizes.begin()->begin(),
+                     collection.num_docs(), collection);
+    ds2i::wand_query<ds2i::quantized_impact> wand_q(impact_wdata, 10);
+    test_against_or(wand_q, impact_wdata);
+}
+
 BOOST_FIXTURE_TEST_CASE(maxscore,
                         ds2i::test::index_initialization)
 {
     ds2i::maxscore_query maxscore_q(wdata, 10);
     test_against_or(maxscore_q);
 }
+
+BOOST_FIXTURE_TEST_CASE(block_ranked_or,
+                        ds2i::test::index_initialization)
+{
+    ds2i::block_ranked_or_query block_ranked_or_q(wdata, 10);
+    test_against_or(block_ranked_or_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_or,
+                        ds2i::test::index_initialization)
+{
+    for (auto const& q: queries) {
+        BOOST_REQUIRE_EQUAL(ds2i::or_query<false>()(index, q),
+                            ds2i::block_or_query<false>()(index, q));
+        BOOST_REQUIRE_EQUAL(ds2i::or_query<true>()(index, q),
+                            ds2i::block_or_query<true>()(index, q));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(block_max_wand,
+                        ds2i::test::index_initialization)
+{
+    ds2i::block_max_wand_query block_max_wand_q(wdata, 10);
+    test_against_or(block_max_wand_q);
+}
+
+BOOST_FIXTURE_TEST_CASE(block_max_maxscore,
+                        ds2i::test::index_initialization)
+{
+    ds2i::block_max_maxscore_query block_max_maxscore_q(wdata, 10);
+    test_against_or(block_max_maxscore_q);
+}
+
+BOOST_AUTO_TEST_CASE(topk_queue_empty)
+{
+    ds2i::topk_queue topk(0);
+    BOOST_REQUIRE(!topk.would_enter(std::numeric_limits<float>::max()));
+    BOOST_REQUIRE(!topk.insert(std::numeric_limits<float>::max(), 1));
+    topk.finalize();
+    BOOST_REQUIRE(topk.topk().empty());
+    topk.clear();
+    BOOST_REQUIRE(!topk.insert(1));
+    BOOST_REQUIRE(topk.topk().empty());
+}
+
+BOOST_AUTO_TEST_CASE(topk_queue)
+{
+    const uint64_t k = 10;
+    ds2i::topk_queue topk(k);
+    for (size_t t = 0; t < 2; ++t) {
+        BOOST_REQUIRE_EQUAL(std::numeric_limits<float>::lowest(),
+                            topk.threshold());
+        BOOST_REQUIRE(topk.would_enter(0));
+
+        // few distinct scores, so that many of them are tied
+        std::vector<float> scores(1000);
+        std::generate(scores.begin(), scores.end(),
+                      []() { return float(rand() % 50) / 2; });
+        for (size_t docid = 0; docid < scores.size(); ++docid) {
+            float score = scores[docid];
+            bool enters = topk.would_enter(score);
+            MY_REQUIRE_EQUAL(enters, topk.insert(score, docid),
+                             "docid = " << docid);
+
+            std::vector<float> top(scores.begin(), scores.begin() + docid + 1);
+            std::sort(top.begin(), top.end(), std::greater<float>());
+            float threshold = top.size() < k
+                ? std::numeric_limits<float>::lowest() : top[k - 1];
+            MY_REQUIRE_EQUAL(threshold, topk.threshold(),
+                             "docid = " << docid);
+            // a score tied with the threshold does not enter
+            BOOST_REQUIRE(!topk.would_enter(topk.threshold()));
+        }
+
+        std::vector<float> top(scores);
+        std::sort(top.begin(), top.end(), std::greater<float>());
+        float threshold = topk.threshold();
+        topk.finalize();
+        BOOST_REQUIRE_EQUAL(threshold, topk.threshold());
+        BOOST_REQUIRE_EQUAL(k, topk.topk().size());
+        for (size_t i = 0; i < k; ++i) {
+            auto const& entry = topk.topk()[i];
+            MY_REQUIRE_EQUAL(top[i], entry.first, "i = " << i);
+            MY_REQUIRE_EQUAL(scores[entry.second], entry.first, "i = " << i);
+        }
+
+        topk.clear();
+        BOOST_REQUIRE(topk.topk().empty());
+    }
+}
+
+// ranked_or_query skips the scoring of the documents whose max scores
+// cannot beat the threshold; its results must be the same as scoring them
+// all
+BOOST_FIXTURE_TEST_CASE(ranked_or_exhaustive,
+                        ds2i::test::index_initialization)
+{
+    typedef ds2i::bm25 scorer_type;
+    uint64_t num_docs = index.num_docs();
+    for (uint64_t k: {0, 1, 10}) {
+        ds2i::ranked_or_query<> or_q(wdata, k);
+        for (auto const& q: queries) {
+            std::vector<float> scores(num_docs, -1);
+            for (auto term: ds2i::query_freqs(q)) {
+                auto list = index[term.first];
+                float q_weight = scorer_type::query_term_weight(
+                    term.second, list.size(), num_docs);
+                for (; list.docid() < num_docs; list.next()) {
+                    float& score = scores[list.docid()];
+                    score = std::max(score, 0.f) + q_weight *
+                        scorer_type::doc_term_weight(
+                            list.freq(), wdata.norm_len(list.docid()));
+                }
+            }
+            std::sort(scores.begin(), scores.end(), std::greater<float>());
+            while (!scores.empty() and scores.back() < 0) scores.pop_back();
+            scores.resize(std::min<uint64_t>(k, scores.size()));
+
+            or_q(index, q);
+            BOOST_REQUIRE_EQUAL(scores.size(), or_q.topk().size());
+            for (size_t i = 0; i < scores.size(); ++i) {
+                BOOST_REQUIRE_CLOSE(scores[i], or_q.topk()[i].first, 0.1);
+            }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#define BOOST_TEST_MODULE statistics_collectors
+
+#include "succinct/test_common.hpp"
+#include "statistics_collectors.hpp"
+#include <vector>
+#include <cstdlib>
+
+// [n] distinct blocks of 4 integers
+std::vector<std::vector<uint32_t>> distinct_blocks(uint32_t n)
+{
+    std::vector<std::vector<uint32_t>> blocks;
+    for (uint32_t i = 0; i != n; ++i) {
+        blocks.push_back({i, i + 1, i % 7, 1 + i / 3});
+    }
+    return blocks;
+}
+
+BOOST_AUTO_TEST_CASE(heavy_hitters_table)
+{
+    // a few frequent blocks among many rare ones
+    ds2i::heavy_hitters_table table(2, 1 << 20);
+    auto blocks = distinct_blocks(4 * table.capacity());
+    srand(42);
+    for (uint32_t i = 0; i != 20 * blocks.size(); ++i) {
+        uint32_t b = rand() % 2 ? rand() % 100 : rand() % blocks.size();
+        table.increase(blocks[b].data(), blocks[b].size(), 1);
+    }
+
+    std::vector<bool> found(100, false);
+    table.for_each([&](uint64_t freq, uint32_t const* data, uint32_t size) {
+        BOOST_REQUIRE_EQUAL(4U, size);
+        BOOST_REQUIRE_GE(freq, 1U);
+        if (data[0] < found.size()) found[data[0]] = true;
+    });
+    BOOST_REQUIRE_LE(table.size(), table.capacity());
+    for (size_t b = 0; b != found.size(); ++b) {
+        MY_REQUIRE_EQUAL(true, bool(found[b]), "b = " << b);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(heavy_hitters_table_tied)
+{
+    // every block is seen the same number of times, so most estimates are
+    // tied when the table is pruned: half of the capacity must be kept
+    const uint64_t k = 3;
+    ds2i::heavy_hitters_table table(1, 1 << 20);
+    auto blocks = distinct_blocks(table.capacity() + table.capacity() / 4);
+    for (uint64_t t = 0; t != k; ++t) {
+        for (auto const& block : blocks) {
+            table.increase(block.data(), block.size(), 1);
+        }
+    }
+
+    BOOST_REQUIRE_GE(table.size(), table.capacity() / 2);
+    BOOST_REQUIRE_LE(table.size(), table.capacity());
+    table.for_each([&](uint64_t freq, uint32_t const*, uint32_t) {
+        BOOST_REQUIRE_GE(freq, k);
+    });
+}
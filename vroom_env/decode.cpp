@@ -239,6 +239,9 @@ int main(int argc, char** argv) {
     } else if (type == std::string("single_packed_dint")) {
         decode_dint<single_opt_dint, single_dictionary_packed_type>(
             type, encoded_data_filename, dictionary_filename);
+    } else if (type == std::string("single_packed_dint_exc")) {
+        decode_dint<single_opt_dint_exceptions, single_dictionary_packed_type>(
+            type, encoded_data_filename, dictionary_filename);
     } else if (type == std::string("multi_packed_dint")) {
         decode_dint<multi_opt_dint, multi_dictionary_packed_type>(
             type, encoded_data_filename, dictionary_filename);
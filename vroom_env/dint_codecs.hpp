@@ -2,6 +2,7 @@
 
 #include "dictionary_types.hpp"
 #include "statistics_collectors.hpp"
+#include "dint_exceptions.hpp"
 
 namespace ds2i {
 
@@ -190,8 +191,8 @@ struct single_greedy_dint {
 struct single_opt_dint {
     // specialized encoding
     template <typename Builder>
-    static void encode(Builder& builder, uint32_t const* begin, uint64_t n,
-                       std::vector<uint8_t>& out, int b) {
+    static void parse(Builder& builder, uint32_t const* begin, uint64_t n,
+                      std::vector<node>& encoding) {
         std::vector<node> path;
         path.resize(n + 2);
         path[0] = {0, 1, 0};  // dummy node
@@ -257,7 +258,7 @@ struct single_opt_dint {
             }
         }
 
-        std::vector<node> encoding;
+        encoding.clear();
         uint32_t i = n;
         while (i != 0) {
             uint32_t parent = path[i].parent;
@@ -267,6 +268,13 @@ struct single_opt_dint {
 
         std::reverse(encoding.begin(), encoding.end());
         encoding.emplace_back(n, 1, -1);  // final dummy node
+    }
+
+    template <typename Builder>
+    static void encode(Builder& builder, uint32_t const* begin, uint64_t n,
+                       std::vector<uint8_t>& out, int b) {
+        std::vector<node> encoding;
+        parse(builder, begin, n, encoding);
 
         for (uint32_t i = 0, pos = 0; i < encoding.size() - 1; ++i) {
             uint32_t index = encoding[i].codeword;
@@ -300,8 +308,6 @@ struct single_opt_dint {
             pos += len;
             assert(pos <= n);
         }
-
-        encoding.clear();
     }
 
     template <typename Builder>
@@ -329,6 +335,33 @@ struct single_opt_dint {
     }
 };
 
+// same parsing as single_opt_dint, with the exceptions of each block of
+// constants::block_size integers laid out as described in dint_exceptions
+struct single_opt_dint_exceptions {
+    template <typename Builder>
+    static void encode(Builder& builder, uint32_t const* in,
+                       uint32_t /*universe*/, uint32_t n,
+                       std::vector<uint8_t>& out) {
+        std::vector<node> encoding;
+        for (uint32_t i = 0; i < n; i += constants::block_size) {
+            uint32_t len = std::min<uint32_t>(constants::block_size, n - i);
+            single_opt_dint::parse(builder, in + i, len, encoding);
+            dint_exceptions::write(encoding, in + i, len, out);
+        }
+    }
+
+    template <typename Dictionary>
+    static uint8_t const* decode(Dictionary const& dict, uint8_t const* in,
+                                 uint32_t* out, uint32_t /*universe*/,
+                                 size_t n) {
+        for (size_t i = 0; i < n; i += constants::block_size) {
+            size_t len = std::min<size_t>(constants::block_size, n - i);
+            in = dint_exceptions::decode(dict, in, out + i, len);
+        }
+        return in;
+    }
+};
+
 struct multi_opt_dint {
     // specialized encoding
     template <typename Builder>
@@ -16,13 +16,12 @@
 #include "util.hpp"
 #include "hash_utils.hpp"
 #include "binary_collection.hpp"
-#include "semiasync_queue.hpp"
+#include "ordered_job_queue.hpp"
 #include "jobs.hpp"
 
 using namespace ds2i;
 
 typedef binary_collection::posting_type const* iterator_type;
-const uint32_t num_jobs = 1 << 24;
 
 void save_if(char const* output_filename, std::vector<uint8_t> const& output) {
     if (output_filename) {
@@ -87,7 +86,7 @@ void encode(std::string const& type, char const* collection_name,
 
     std::vector<uint32_t> buf;
     boost::progress_display progress(total_progress);
-    semiasync_queue jobs_queue(num_jobs);
+    ordered_job_queue jobs_queue;
 
     for (; it != input.end(); ++it) {
         auto const& list = *it;
@@ -172,7 +171,7 @@ void encode_dint(std::string const& type, char const* collection_name,
 
     std::vector<uint32_t> buf;
     boost::progress_display progress(total_progress);
-    semiasync_queue jobs_queue(num_jobs);
+    ordered_job_queue jobs_queue;
 
     for (; it != input.end(); ++it) {
         auto const& list = *it;
@@ -214,7 +213,7 @@ void encode_pef(char const* collection_name, char const* output_filename) {
 
     succinct::bit_vector_builder bvb;
     boost::progress_display progress(total_progress);
-    semiasync_queue jobs_queue(num_jobs);
+    ordered_job_queue jobs_queue;
 
     for (; it != input.end(); ++it) {
         auto const& list = *it;
@@ -305,6 +304,9 @@ int main(int argc, char** argv) {
     } else if (type == std::string("single_packed_dint")) {
         encode_dint<single_opt_dint, single_dictionary_packed_type>(
             type, collection_name, output_filename, dictionary_filename);
+    } else if (type == std::string("single_packed_dint_exc")) {
+        encode_dint<single_opt_dint_exceptions, single_dictionary_packed_type>(
+            type, collection_name, output_filename, dictionary_filename);
     } else if (type == std::string("multi_packed_dint")) {
         encode_dint<multi_opt_dint, multi_dictionary_packed_type>(
             type, collection_name, output_filename, dictionary_filename);
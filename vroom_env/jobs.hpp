@@ -1,12 +1,12 @@
 #pragma once
 
-#include "semiasync_queue.hpp"
+#include "ordered_job_queue.hpp"
 
 namespace ds2i {
 
 // for generic block-codec
 template <typename Iterator, typename Encoder>
-struct enc_sequence_adder : semiasync_queue::job {
+struct enc_sequence_adder : ordered_job_queue::job {
     enc_sequence_adder(Iterator begin, uint64_t n,
                        boost::progress_display& progress,
                        std::vector<uint8_t>& output, bool docs,
@@ -56,7 +56,7 @@ struct enc_sequence_adder : semiasync_queue::job {
 
 // for DINT
 template <typename Iterator, typename Encoder, typename Builder>
-struct dint_sequence_adder : semiasync_queue::job {
+struct dint_sequence_adder : ordered_job_queue::job {
     dint_sequence_adder(Iterator begin, uint64_t n, Builder& builder,
                         boost::progress_display& progress,
                         std::vector<uint8_t>& output, bool docs,
@@ -108,7 +108,7 @@ struct dint_sequence_adder : semiasync_queue::job {
 
 // for PEF
 template <typename Iterator>
-struct pef_sequence_adder : semiasync_queue::job {
+struct pef_sequence_adder : ordered_job_queue::job {
     pef_sequence_adder(Iterator begin, uint64_t n, uint64_t universe,
                        succinct::bit_vector_builder& bvb,
                        boost::progress_display& progress, bool docs,